@@ -0,0 +1,365 @@
+#include "checkpoint.h"
+
+/**
+ * @brief Offset of the first population in a checkpoint file
+ *
+ * @param[in] num_countries
+ * @param[in] num_summaries
+ * @return uint64_t
+ */
+static uint64_t checkpoint_data_offset(int num_countries,
+                                       size_t num_summaries) {
+  return sizeof(checkpoint_header_t) +
+         num_countries * sizeof(checkpoint_country_t) +
+         num_summaries *
+             (sizeof(unsigned long) + num_countries * sizeof(summary_t));
+}
+
+/**
+ * @brief Copies a column at the end of a buffer, advancing it
+ *
+ * @param[in,out] dst pointer to the end of the buffer
+ * @param[in] src column
+ * @param[in] size number of bytes
+ */
+static void pack_column(char **dst, const void *src, size_t size) {
+  memcpy(*dst, src, size);
+  *dst += size;
+}
+
+/**
+ * @brief Reads raw data from a checkpoint file, advancing the offset
+ *
+ * The data is read in chunks of at most \c CHECKPOINT_IO_CHUNK bytes.
+ *
+ * @param[in] fh checkpoint file
+ * @param[in,out] offset offset of the data from the start of the file
+ * @param[out] dst
+ * @param[in] size number of bytes
+ */
+static void read_data(MPI_File fh, MPI_Offset *offset, void *dst,
+                      size_t size) {
+  char *end = dst;
+  while (size > 0) {
+    const int chunk = MIN(size, CHECKPOINT_IO_CHUNK);
+    MPI_File_read_at(fh, *offset, end, chunk, MPI_BYTE, MPI_STATUS_IGNORE);
+    *offset += chunk;
+    end += chunk;
+    size -= chunk;
+  }
+}
+
+/**
+ * @brief Writes raw data to a checkpoint file, advancing the offset
+ *
+ * The data is written in chunks of at most \c CHECKPOINT_IO_CHUNK bytes.
+ *
+ * @param[in] fh checkpoint file
+ * @param[in,out] offset offset of the data from the start of the file
+ * @param[in] src
+ * @param[in] size number of bytes
+ */
+static void write_data(MPI_File fh, MPI_Offset *offset, const void *src,
+                       size_t size) {
+  const char *end = src;
+  while (size > 0) {
+    const int chunk = MIN(size, CHECKPOINT_IO_CHUNK);
+    MPI_File_write_at(fh, *offset, end, chunk, MPI_BYTE, MPI_STATUS_IGNORE);
+    *offset += chunk;
+    end += chunk;
+    size -= chunk;
+  }
+}
+
+/**
+ * @brief Writes raw data to a checkpoint file collectively
+ *
+ * The whole chunks of \c CHECKPOINT_IO_CHUNK bytes are written as elements of
+ * a contiguous type, and the rest as bytes, so that the counts fit in an int.
+ *
+ * Must be called by all the processes that opened the file.
+ *
+ * @param[in] fh checkpoint file
+ * @param[in] offset offset of the data from the start of the file
+ * @param[in] src
+ * @param[in] size number of bytes
+ */
+static void write_data_all(MPI_File fh, MPI_Offset offset, const void *src,
+                           size_t size) {
+  MPI_Datatype chunk_type;
+  const size_t chunks = size / CHECKPOINT_IO_CHUNK;
+  const size_t rest = size % CHECKPOINT_IO_CHUNK;
+  MPI_Type_contiguous(CHECKPOINT_IO_CHUNK, MPI_BYTE, &chunk_type);
+  MPI_Type_commit(&chunk_type);
+  MPI_File_write_at_all(fh, offset, src, chunks, chunk_type,
+                        MPI_STATUS_IGNORE);
+  MPI_File_write_at_all(fh, offset + chunks * CHECKPOINT_IO_CHUNK,
+                        (const char *)src + chunks * CHECKPOINT_IO_CHUNK, rest,
+                        MPI_BYTE, MPI_STATUS_IGNORE);
+  MPI_Type_free(&chunk_type);
+}
+
+/**
+ * @brief Checks that a checkpoint describes the same world and motion as the
+ * configuration, and warns about any other parameter that differs
+ *
+ * The displacements and the motion of the immune individuals are restored as
+ * written, so they hold only for the same velocity and step; the reach of the
+ * exposure would also be sized for a different motion.
+ *
+ * @param[in] header header of the checkpoint
+ * @param[in] cfg global configuration
+ * @param[in] domain
+ * @return int status (0: ok, 1: error)
+ */
+static int check_checkpoint_header(checkpoint_header_t *header,
+                                   global_config_t *cfg, domain_t *domain) {
+  global_config_t *saved = &header->config;
+  const bool log = domain->rank == ROOT_RANK;
+  if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != CHECKPOINT_VERSION ||
+      header->config_size != sizeof(global_config_t)) {
+    if (log) {
+      log_error("Not a checkpoint written by this program");
+    }
+    return 1;
+  }
+  if (header->num_countries != domain->num_countries ||
+      saved->world_w != cfg->world_w || saved->world_l != cfg->world_l ||
+      saved->country_w != cfg->country_w ||
+      saved->country_l != cfg->country_l ||
+      saved->num_individuals != cfg->num_individuals) {
+    if (log) {
+      log_error("The checkpoint was written for a different world");
+    }
+    return 1;
+  }
+  if (saved->velocity != cfg->velocity || saved->t_step != cfg->t_step) {
+    if (log) {
+      log_error("The checkpoint was written with a different velocity or step");
+    }
+    return 1;
+  }
+  if (log && (saved->spreading_distance != cfg->spreading_distance ||
+              saved->t_infection != cfg->t_infection ||
+              saved->t_recovery != cfg->t_recovery ||
+              saved->t_immunity != cfg->t_immunity)) {
+    log_warn("Resuming with parameters different from the checkpoint");
+  }
+  return 0;
+}
+
+/**
+ * @brief Writes the state of the simulation to a checkpoint file, with
+ * collective MPI-IO
+ *
+ * Each process writes its populations as a contiguous part of the file, at the
+ * offset given by the exclusive prefix sum of the sizes of the previous ranks,
+ * while root writes the header, the table of the countries and the summaries.
+ * The file is first written as \p path .tmp and then renamed, so that the
+ * previous checkpoint is replaced only once the new one is complete.
+ *
+ * Must be called by all the processes of the domain.
+ *
+ * @param[in] path path of the checkpoint file
+ * @param[in] cfg global configuration
+ * @param[in] domain
+ * @param[in] t time of the next step
+ * @param[in] t_last_summary time of the last summary
+ * @param[in] summaries summaries reduced so far, only meaningful on root
+ * @param[in] summary_days day of each summary, only meaningful on root
+ * @param[in] num_summaries number of summaries reduced so far
+ * @return int status (0: ok, 1: error)
+ */
+int write_checkpoint(const char *path, global_config_t *cfg, domain_t *domain,
+                     unsigned long t, unsigned long t_last_summary,
+                     summary_t summaries[], unsigned long summary_days[],
+                     size_t num_summaries) {
+  const int num_countries = domain->num_countries;
+  const int rank = domain->rank;
+  MPI_File fh;
+
+  /* Open the temporary file, removing any previous, longer one */
+  char *tmp_path = malloc(PATH_MAX * sizeof(char));
+  snprintf(tmp_path, PATH_MAX, "%s.tmp", path);
+  if (rank == ROOT_RANK) {
+    MPI_File_delete(tmp_path, MPI_INFO_NULL);
+  }
+  MPI_Barrier(domain->comm);
+  if (MPI_File_open(domain->comm, tmp_path, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                    MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+    log_error("Cannot open file \"%s\" for writing", tmp_path);
+    free(tmp_path);
+    return 1;
+  }
+
+  /* Pack the local populations */
+  checkpoint_country_t *table =
+      calloc(num_countries, sizeof(checkpoint_country_t));
+  uint64_t size = 0, offset = 0;
+  for (int k = 0; k < domain->num_local; k++) {
+    size += domain->countries[k].population.len * CHECKPOINT_ITEM_SIZE;
+  }
+  char *buffer = malloc(size);
+  char *end = buffer;
+  for (int k = 0; k < domain->num_local; k++) {
+    population_t *pop = &domain->countries[k].population;
+    checkpoint_country_t *entry = &table[domain->countries[k].id];
+    entry->offset = end - buffer;
+    entry->len = pop->len;
+    entry->infected_begin = pop->infected_begin;
+    entry->immune_begin = pop->immune_begin;
+    pack_column(&end, pop->id, pop->len * sizeof(unsigned long));
+    pack_column(&end, pop->pos_x, pop->len * sizeof(double));
+    pack_column(&end, pop->pos_y, pop->len * sizeof(double));
+    pack_column(&end, pop->displ_x, pop->len * sizeof(double));
+    pack_column(&end, pop->displ_y, pop->len * sizeof(double));
+    pack_column(&end, pop->t_status, pop->len * sizeof(unsigned long));
+    pack_column(&end, pop->t_motion, pop->len * sizeof(unsigned long));
+    pack_column(&end, pop->status, pop->len * sizeof(unsigned char));
+  }
+
+  /* Write the populations collectively */
+  /* NOTE: uint64_t is an unsigned long */
+  MPI_Exscan(&size, &offset, 1, MPI_UNSIGNED_LONG, MPI_SUM, domain->comm);
+  /* MPI_Exscan leaves the result undefined on the first rank */
+  if (rank == 0) {
+    offset = 0;
+  }
+  offset += checkpoint_data_offset(num_countries, num_summaries);
+  for (int k = 0; k < domain->num_local; k++) {
+    table[domain->countries[k].id].offset += offset;
+  }
+  write_data_all(fh, offset, buffer, size);
+  free(buffer);
+
+  /* Gather the table on root, where the entries of the other processes are
+   * zero, and write the rest of the file */
+  if (rank == ROOT_RANK) {
+    checkpoint_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.num_countries = num_countries;
+    header.t = t;
+    header.t_last_summary = t_last_summary;
+    header.num_summaries = num_summaries;
+    header.config_size = sizeof(global_config_t);
+    header.config = *cfg;
+    MPI_Reduce(MPI_IN_PLACE, table, 4 * num_countries, MPI_UNSIGNED_LONG,
+               MPI_SUM, ROOT_RANK, domain->comm);
+    MPI_Offset pos = 0;
+    write_data(fh, &pos, &header, sizeof(header));
+    write_data(fh, &pos, table, num_countries * sizeof(checkpoint_country_t));
+    write_data(fh, &pos, summary_days, num_summaries * sizeof(unsigned long));
+    write_data(fh, &pos, summaries,
+               num_summaries * num_countries * sizeof(summary_t));
+  } else {
+    MPI_Reduce(table, NULL, 4 * num_countries, MPI_UNSIGNED_LONG, MPI_SUM,
+               ROOT_RANK, domain->comm);
+  }
+  free(table);
+  MPI_File_close(&fh);
+
+  /* Replace the previous checkpoint */
+  int status = 0;
+  if (rank == ROOT_RANK) {
+    if (rename(tmp_path, path) != 0) {
+      log_error("Cannot rename \"%s\" to \"%s\"", tmp_path, path);
+      status = 1;
+    } else {
+      log_info("Checkpoint written at t=%lu", t);
+    }
+  }
+  MPI_Bcast(&status, 1, MPI_INT, ROOT_RANK, domain->comm);
+  free(tmp_path);
+  return status;
+}
+
+/**
+ * @brief Reads the state of the simulation from a checkpoint file
+ *
+ * Each process reads the populations of its own countries, which must be
+ * empty, wherever they were written, so the file can come from a run with a
+ * different number of processes. Root also reads the summaries.
+ *
+ * Must be called by all the processes of the domain.
+ *
+ * @param[in] path path of the checkpoint file
+ * @param[in] cfg global configuration, which must describe the same world as
+ * the one of the checkpoint
+ * @param[in,out] domain
+ * @param[out] t time of the next step
+ * @param[out] t_last_summary time of the last summary
+ * @param[out] summaries dynamically allocated summaries, only on root
+ * @param[out] summary_days dynamically allocated day of each summary, only on
+ * root
+ * @param[out] num_summaries number of summaries
+ * @return int status (0: ok, 1: error)
+ */
+int read_checkpoint(const char *path, global_config_t *cfg, domain_t *domain,
+                    unsigned long *t, unsigned long *t_last_summary,
+                    summary_t **summaries, unsigned long **summary_days,
+                    size_t *num_summaries) {
+  const int num_countries = domain->num_countries;
+  MPI_File fh;
+  if (MPI_File_open(domain->comm, path, MPI_MODE_RDONLY, MPI_INFO_NULL,
+                    &fh) != MPI_SUCCESS) {
+    log_error("Cannot open file \"%s\" for reading", path);
+    return 1;
+  }
+
+  /* Read the header, which is the same on all the processes */
+  checkpoint_header_t header;
+  MPI_File_read_at_all(fh, 0, &header, sizeof(header), MPI_BYTE,
+                       MPI_STATUS_IGNORE);
+  if (check_checkpoint_header(&header, cfg, domain) != 0) {
+    MPI_File_close(&fh);
+    return 1;
+  }
+  *t = header.t;
+  *t_last_summary = header.t_last_summary;
+  *num_summaries = header.num_summaries;
+
+  /* Read the table of the countries, then the local populations */
+  checkpoint_country_t *table =
+      malloc(num_countries * sizeof(checkpoint_country_t));
+  MPI_Offset pos = sizeof(header);
+  MPI_File_read_at_all(fh, pos, table,
+                       num_countries * sizeof(checkpoint_country_t), MPI_BYTE,
+                       MPI_STATUS_IGNORE);
+  pos += num_countries * sizeof(checkpoint_country_t);
+  for (int k = 0; k < domain->num_local; k++) {
+    population_t *pop = &domain->countries[k].population;
+    checkpoint_country_t *entry = &table[domain->countries[k].id];
+    MPI_Offset offset = entry->offset;
+    const size_t len = entry->len;
+    population_reserve(pop, len);
+    read_data(fh, &offset, pop->id, len * sizeof(unsigned long));
+    read_data(fh, &offset, pop->pos_x, len * sizeof(double));
+    read_data(fh, &offset, pop->pos_y, len * sizeof(double));
+    read_data(fh, &offset, pop->displ_x, len * sizeof(double));
+    read_data(fh, &offset, pop->displ_y, len * sizeof(double));
+    read_data(fh, &offset, pop->t_status, len * sizeof(unsigned long));
+    read_data(fh, &offset, pop->t_motion, len * sizeof(unsigned long));
+    read_data(fh, &offset, pop->status, len * sizeof(unsigned char));
+    pop->len = len;
+    pop->infected_begin = entry->infected_begin;
+    pop->immune_begin = entry->immune_begin;
+    population_schedule(pop, header.t);
+  }
+  free(table);
+
+  /* Read the summaries on root */
+  *summaries = NULL;
+  *summary_days = NULL;
+  if (domain->rank == ROOT_RANK) {
+    const size_t n = header.num_summaries;
+    *summary_days = malloc(n * sizeof(unsigned long));
+    *summaries = malloc(n * num_countries * sizeof(summary_t));
+    read_data(fh, &pos, *summary_days, n * sizeof(unsigned long));
+    read_data(fh, &pos, *summaries, n * num_countries * sizeof(summary_t));
+  }
+  MPI_File_close(&fh);
+  return 0;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <limits.h>
+#include <mpi.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "country.h"
+#include "domain.h"
+#include "individual.h"
+#include "population.h"
+#include "utils.h"
+
+/*
+ * Binary checkpoint file, in the native byte order:
+ *  - checkpoint_header_t , with the time and the configuration
+ *  - one checkpoint_country_t for each country of the world, locating its
+ *    population
+ *  - the day of each summary reduced so far (uint64), followed by the
+ *    summaries themselves, \c num_countries summary_t for each day
+ *  - the population of each country, as the columns id (uint64), pos_x, pos_y,
+ *    displ_x, displ_y (double), t_status, t_motion (uint64) and status
+ *    (uint8), with the countries of each process contiguous, in the order of
+ *    the ranks. As in population_t , the infected and immune individuals
+ *    record in t_status the time of the first step they spent in the status,
+ *    and the immune ones record their motion at time t_motion
+ *
+ * The populations are located through the table of the countries, so the file
+ * can be read by any number of processes.
+ */
+
+#define CHECKPOINT_MAGIC "MPICKPNT"
+#define CHECKPOINT_VERSION 3
+
+/* Size in bytes of an individual in the populations of a checkpoint file */
+#define CHECKPOINT_ITEM_SIZE \
+  (3 * sizeof(uint64_t) + 4 * sizeof(double) + sizeof(uint8_t))
+
+/* Largest number of bytes moved by a single MPI-IO call, since its count is an
+ * int */
+#define CHECKPOINT_IO_CHUNK (1 << 30)
+
+/**
+ * @brief Header of a checkpoint file
+ */
+typedef struct checkpoint_header {
+  char magic[8]; /**< CHECKPOINT_MAGIC , not null-terminated */
+  uint32_t version;
+  int32_t num_countries;
+  uint64_t t;              /**< Time of the next step */
+  uint64_t t_last_summary; /**< Time of the last summary */
+  uint64_t num_summaries;  /**< Number of summaries reduced so far */
+  uint64_t config_size;    /**< Size of the configuration, to detect files
+                              written by another build */
+  global_config_t config;  /**< Configuration of the writer */
+} checkpoint_header_t;
+
+/**
+ * @brief Entry of the table of the countries, locating a population
+ */
+typedef struct checkpoint_country {
+  uint64_t offset; /**< Offset of the columns from the start of the file */
+  uint64_t len;    /**< Number of individuals */
+  uint64_t infected_begin, immune_begin;
+} checkpoint_country_t;
+
+int write_checkpoint(const char *path, global_config_t *cfg, domain_t *domain,
+                     unsigned long t, unsigned long t_last_summary,
+                     summary_t summaries[], unsigned long summary_days[],
+                     size_t num_summaries);
+
+int read_checkpoint(const char *path, global_config_t *cfg, domain_t *domain,
+                    unsigned long *t, unsigned long *t_last_summary,
+                    summary_t **summaries, unsigned long **summary_days,
+                    size_t *num_summaries);
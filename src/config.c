@@ -1,5 +1,7 @@
 #include "config.h"
 
+#include "exposure-engine.h"
+
 /* Argument parser variables */
 const char *argp_program_bug_address = "alessandro.fulgini@mail.polimi.it";
 const char *argp_program_version = "0.1-alpha";
@@ -120,6 +122,74 @@ int parse_opt(int key, char *arg, struct argp_state *state) {
       cfg->write_trace = true;
       break;
     }
+    case 111111: {
+      cfg->num_threads = strtol(arg, NULL, 10);
+      break;
+    }
+    case 121212: {
+      cfg->balance_every = strtoul(arg, NULL, 10);
+      break;
+    }
+    case 131313: {
+      cfg->compact_migration = true;
+      break;
+    }
+    case 141414: {
+      cfg->check_every = strtoul(arg, NULL, 10);
+      break;
+    }
+    case 151515: {
+      cfg->write_trace = true;
+      cfg->shared_trace = true;
+      break;
+    }
+    case 161616: {
+      cfg->write_trace = true;
+      cfg->trace_every = strtoul(arg, NULL, 10);
+      break;
+    }
+    case 171717: {
+      cfg->write_trace = true;
+      cfg->trace_sample_rate = strtod(arg, NULL);
+      break;
+    }
+    case 181818: {
+      double *r = cfg->trace_region;
+      cfg->write_trace = true;
+      /* An invalid region is left empty, and rejected by the validation */
+      if (sscanf(arg, "%lf,%lf,%lf,%lf", &r[0], &r[2], &r[1], &r[3]) != 4) {
+        r[0] = r[1] = r[2] = r[3] = 0.;
+      }
+      break;
+    }
+    case 191919: {
+      cfg->checkpoint_every = strtoul(arg, NULL, 10);
+      break;
+    }
+    case 202020: {
+      if (strlen(arg) >= sizeof(cfg->restart_from)) {
+        log_error("Checkpoint path is too long");
+        return EINVAL;
+      }
+      strcpy(cfg->restart_from, arg);
+      break;
+    }
+    case 212121: {
+      cfg->verlet_skin = strtod(arg, NULL);
+      break;
+    }
+    case 222222: {
+      cfg->exposure_engine = decode_exposure_engine(arg);
+      break;
+    }
+    case 232323: {
+      cfg->swept_exposure = true;
+      break;
+    }
+    case 242424: {
+      cfg->locality_every = strtoul(arg, NULL, 10);
+      break;
+    }
     case ARGP_KEY_INIT: {
       a->argz = 0;
       a->argz_len = 0;
@@ -149,6 +219,21 @@ void init_config_default(global_config_t *cfg) {
   cfg->rand_seed = time(NULL);
   cfg->log_level = LOG_DEFAULT;
   cfg->write_trace = false;
+  cfg->num_threads = 1;
+  cfg->balance_every = 0;
+  cfg->compact_migration = false;
+  cfg->check_every = 1;
+  cfg->shared_trace = false;
+  cfg->trace_every = 1;
+  cfg->trace_sample_rate = 1.;
+  cfg->trace_region[0] = cfg->trace_region[2] = -INFINITY;
+  cfg->trace_region[1] = cfg->trace_region[3] = INFINITY;
+  cfg->checkpoint_every = 0;
+  cfg->restart_from[0] = '\0';
+  cfg->verlet_skin = 0.;
+  cfg->exposure_engine = EXPOSURE_GRID;
+  cfg->swept_exposure = false;
+  cfg->locality_every = 0;
 }
 
 /**
@@ -180,10 +265,10 @@ int validate_config(global_config_t *cfg, int world_size) {
   }
   int num_countries =
       (cfg->world_w / cfg->country_w) * (cfg->world_l / cfg->country_l);
-  if (world_size != num_countries) {
+  if (world_size > num_countries) {
     log_error(
-        "Number of processes does not match number of countries. "
-        "Expected %d, got %d",
+        "Number of processes exceeds number of countries. "
+        "Expected at most %d, got %d",
         num_countries, world_size);
     return 1;
   }
@@ -197,6 +282,51 @@ int validate_config(global_config_t *cfg, int world_size) {
     log_error("Spreading distance must be non-negative");
     return 1;
   }
+  /* Verlet skin */
+  if (!(cfg->verlet_skin >= 0.)) {
+    log_error("Verlet skin must be non-negative");
+    return 1;
+  }
+  /* Exposure engine */
+  if (cfg->exposure_engine < 0) {
+    log_error("Exposure engine must be one of auto, brute, grid, kdtree");
+    return 1;
+  }
+  if (cfg->swept_exposure && cfg->exposure_engine == EXPOSURE_KDTREE) {
+    log_error("Swept exposure is not supported by the kdtree engine");
+    return 1;
+  }
+  /* Threads */
+  if (cfg->num_threads < 1) {
+    log_error("Number of threads must be positive");
+    return 1;
+  }
+  /* Termination checks */
+  if (cfg->check_every < 1) {
+    log_error("Steps between termination checks must be positive");
+    return 1;
+  }
+  /* Trace filters */
+  if (cfg->trace_every < 1) {
+    log_error("Steps between traced steps must be positive");
+    return 1;
+  }
+  if (!(cfg->trace_sample_rate > 0. && cfg->trace_sample_rate <= 1.)) {
+    log_error("Trace sample rate must be in (0, 1]");
+    return 1;
+  }
+  if (!(cfg->trace_region[0] < cfg->trace_region[1] &&
+        cfg->trace_region[2] < cfg->trace_region[3])) {
+    log_error("Trace region must be XMIN,YMIN,XMAX,YMAX with XMIN < XMAX and "
+              "YMIN < YMAX");
+    return 1;
+  }
+  /* Status timers must fit the migrant records */
+  if (MAX(cfg->t_infection, MAX(cfg->t_recovery, cfg->t_immunity)) >
+      MIGRANT_TIMER_MAX) {
+    log_error("Status durations cannot exceed %lu seconds", MIGRANT_TIMER_MAX);
+    return 1;
+  }
   /* Simulation step */
   if (cfg->t_step > DAY) {
     log_error("Simulation step cannot be longer than one day");
@@ -210,11 +340,34 @@ int validate_config(global_config_t *cfg, int world_size) {
         cfg->t_step * cfg->velocity, MIN(cfg->country_w, cfg->country_l));
     return 1;
   }
+  /* Only the neighbor countries share the infected close to their border, so
+   * the exposure cannot reach beyond them */
+  if (calculate_exposure_reach(cfg) > MIN(cfg->country_w, cfg->country_l)) {
+    log_error("The exposure reaches farther than a country: %f > %lu",
+              calculate_exposure_reach(cfg),
+              MIN(cfg->country_w, cfg->country_l));
+    return 1;
+  }
 
   /* If we got here the configuration is valid */
   return 0;
 }
 
+/**
+ * @brief Calculates the largest distance at the start of a step from which an
+ * infected individual can expose a susceptible one during the step
+ *
+ * It is the spreading distance, plus the largest approach of two individuals
+ * in a step if the exposure is swept.
+ *
+ * @param[in] cfg configuration
+ * @return double distance in meters
+ */
+double calculate_exposure_reach(global_config_t *cfg) {
+  return cfg->spreading_distance +
+         (cfg->swept_exposure ? 2 * cfg->velocity * cfg->t_step : 0.);
+}
+
 /**
  * @brief Logs the configuration with level INFO.
  *
@@ -227,11 +380,21 @@ void log_config(global_config_t *cfg) {
       "inf_individuals %lu\n world_w %lu\n world_l %lu\n country_w %lu\n "
       "country_l %lu\n velocity %f\n spreading_distance %f\n t_infection "
       "%lu\n t_recovery %lu\n t_immunity %lu\n t_step %lu\n t_target "
-      "%lu\n rand_seed %u\n log_level %s\n write_trace "
-      "%d\n--------------------\n",
+      "%lu\n rand_seed %u\n log_level %s\n write_trace %d\n num_threads "
+      "%d\n balance_every %lu\n compact_migration %d\n check_every "
+      "%lu\n shared_trace %d\n trace_every %lu\n trace_sample_rate %f\n "
+      "trace_region %f,%f,%f,%f\n checkpoint_every %lu\n restart_from "
+      "%s\n verlet_skin %f\n exposure_engine %s\n swept_exposure "
+      "%d\n locality_every %lu\n--------------------\n",
       cfg->num_individuals, cfg->inf_individuals, cfg->world_w, cfg->world_l,
       cfg->country_w, cfg->country_l, cfg->velocity, cfg->spreading_distance,
       cfg->t_infection, cfg->t_recovery, cfg->t_immunity, cfg->t_step,
       cfg->t_target, cfg->rand_seed, log_level_string(cfg->log_level),
-      cfg->write_trace);
+      cfg->write_trace, cfg->num_threads, cfg->balance_every,
+      cfg->compact_migration, cfg->check_every, cfg->shared_trace,
+      cfg->trace_every, cfg->trace_sample_rate, cfg->trace_region[0],
+      cfg->trace_region[2], cfg->trace_region[1], cfg->trace_region[3],
+      cfg->checkpoint_every, cfg->restart_from, cfg->verlet_skin,
+      exposure_engine_string(cfg->exposure_engine), cfg->swept_exposure,
+      cfg->locality_every);
 }
\ No newline at end of file
@@ -2,10 +2,12 @@
 
 #include <argp.h>
 #include <argz.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
+#include "individual.h"
 #include "utils.h"
 
 #define LOG_DEFAULT LOG_INFO
@@ -26,6 +28,25 @@ typedef struct {
   unsigned int rand_seed;
   int log_level;
   bool write_trace; /**< Write a file with details of each ind. at each step */
+  int num_threads;  /**< Number of threads for each process */
+  unsigned long balance_every; /**< Steps between load balancing, 0 if never */
+  bool compact_migration; /**< Send the migrating individuals in compact
+                             format */
+  unsigned long check_every; /**< Steps between termination checks */
+  bool shared_trace; /**< Write a single trace shared by all the processes */
+  unsigned long trace_every; /**< Steps between traced steps */
+  double trace_sample_rate;  /**< Fraction of the ids that are traced */
+  double trace_region[4]; /**< xmin, xmax, ymin, ymax of the traced region */
+  unsigned long checkpoint_every; /**< Steps between checkpoints, 0 if never */
+  char restart_from[PATH_MAX]; /**< Checkpoint to resume from, empty if none */
+  double verlet_skin; /**< Skin of the Verlet flags for the exposure, 0 if
+                         not used */
+  int exposure_engine; /**< Algorithm of the exposure, as in
+                          exposure_engine_t */
+  bool swept_exposure; /**< Follow the individuals along each step for the
+                          exposure, instead of only at its start */
+  unsigned long locality_every; /**< Steps between checks of the locality of
+                                   the populations, 0 if never */
 } global_config_t;
 
 /* Argument parser structures */
@@ -41,4 +62,6 @@ void init_config_default(global_config_t *cfg);
 
 void log_config(global_config_t *cfg);
 
-int validate_config(global_config_t *cfg, int world_size);
\ No newline at end of file
+int validate_config(global_config_t *cfg, int world_size);
+
+double calculate_exposure_reach(global_config_t *cfg);
\ No newline at end of file
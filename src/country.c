@@ -0,0 +1,164 @@
+#include "country.h"
+
+/**
+ * @brief Creates an empty country
+ *
+ * @param[in] cfg global configuration
+ * @param[in] num_countries total number of countries
+ * @param[in] id index of the country in the world
+ * @return country_t
+ */
+country_t create_country(global_config_t *cfg, int num_countries, int id) {
+  country_t country;
+  country.id = id;
+  country.limits = calculate_country_limits(cfg, num_countries, id);
+  calculate_neighbors(country.neighbors, cfg, num_countries, id);
+  country.population = create_population();
+  population_set_motion(&country.population, &country.limits,
+                        country.neighbors, cfg->world_w, cfg->world_l,
+                        cfg->t_step);
+  /* The grid of the index has a margin for the infected individuals of
+   * neighbor countries, and its cells can be searched within the Verlet
+   * radius */
+  const double reach = calculate_exposure_reach(cfg);
+  country.infected_index =
+      create_exposure_index(&country.limits, reach, reach + cfg->verlet_skin,
+                            cfg->exposure_engine, cfg->swept_exposure);
+  /* Two individuals get closer by at most twice their displacement at each
+   * step, so the Verlet flags hold while the sum stays below the skin. They
+   * are computed at the first step. */
+  country.verlet_skin = cfg->verlet_skin;
+  country.verlet_steps = 0;
+  if (cfg->verlet_skin > 0.) {
+    double approach = 2 * cfg->velocity * cfg->t_step;
+    country.verlet_steps = (unsigned long)ceil(cfg->verlet_skin / approach) - 1;
+  }
+  country.verlet_age = country.verlet_steps;
+  country.halo = NULL;
+  country.halo_len = country.halo_capacity = 0;
+  for (int i = 0; i < NEIGHBOR_COUNT; i++) {
+    country.migrated_out[i] = NULL;
+    country.migrated_out_len[i] = country.migrated_out_capacity[i] = 0;
+  }
+  country.cost = 0.;
+  country.locality = 0.;
+  country.step_time = 0.;
+  country.sort_step_time = -1.;
+  country.sort_time = country.work_time = 0.;
+  return country;
+}
+
+/**
+ * @brief Frees the dynamically allocated buffers of a country
+ *
+ * @param[in,out] country
+ */
+void free_country(country_t *country) {
+  free_population(&country->population);
+  free_exposure_index(&country->infected_index);
+  free(country->halo);
+  for (int i = 0; i < NEIGHBOR_COUNT; i++) {
+    free(country->migrated_out[i]);
+  }
+}
+
+/**
+ * @brief Calculate the min and max x and y values for a country.
+ *
+ * @param[in] cfg global configuration
+ * @param[in] num_countries total number of countries
+ * @param[in] country index of the country
+ * @return limits_t a struct with the calculated limits
+ */
+limits_t calculate_country_limits(global_config_t *cfg, int num_countries,
+                                  int country) {
+  /* Determine row and column of this country */
+  int cols = (cfg->world_w / cfg->country_w);
+  int col = country % cols;
+  int row = country / cols;
+  /* Build the struct with the values */
+  limits_t limits = {
+      col * cfg->country_w,       /* xmin */
+      (col + 1) * cfg->country_w, /* xmax */
+      row * cfg->country_l,       /* ymin */
+      (row + 1) * cfg->country_l, /* ymax */
+  };
+  return limits;
+}
+
+/**
+ * @brief Calculates the indices of the neighbors of a country
+ *
+ * @param[out] neighbors array where the results will be stored
+ * @param[in] cfg global configuration
+ * @param[in] num_countries total number of countries
+ * @param[in] country index of the country
+ */
+void calculate_neighbors(int neighbors[], global_config_t *cfg,
+                         int num_countries, int country) {
+  /* Determine row and column of this country */
+  int cols = (cfg->world_w / cfg->country_w);
+  int rows = (cfg->world_l / cfg->country_l);
+  int col = country % cols;
+  int row = country / cols;
+
+  /* Set indices as if this were an internal node */
+  neighbors[SOUTH_EAST] = country - cols + 1;
+  neighbors[SOUTH] = country - cols;
+  neighbors[SOUTH_WEST] = country - cols - 1;
+  neighbors[NORTH_EAST] = country + cols + 1;
+  neighbors[NORTH] = country + cols;
+  neighbors[NORTH_WEST] = country + cols - 1;
+  neighbors[WEST] = country - 1;
+  neighbors[EAST] = country + 1;
+
+  /* Correct the indices by considering the world boundaries */
+  if (row == 0) { /* bottom row */
+    neighbors[SOUTH_EAST] = -1;
+    neighbors[SOUTH] = -1;
+    neighbors[SOUTH_WEST] = -1;
+  }
+  if (row == rows - 1) { /* top row */
+    neighbors[NORTH_EAST] = -1;
+    neighbors[NORTH] = -1;
+    neighbors[NORTH_WEST] = -1;
+  }
+
+  if (col == 0) { /* first column */
+    neighbors[SOUTH_WEST] = -1;
+    neighbors[WEST] = -1;
+    neighbors[NORTH_WEST] = -1;
+  }
+  if (col == cols - 1) { /* last column */
+    neighbors[NORTH_EAST] = -1;
+    neighbors[EAST] = -1;
+    neighbors[SOUTH_EAST] = -1;
+  }
+}
+
+/**
+ * @brief Checks whether a position lies within a distance from a country,
+ * along both axes
+ *
+ * The comparisons are the same made by \c update_halo_out() on the other side
+ * of the border, so both sides agree on which countries a ghost is relevant to.
+ *
+ * @param[in] country
+ * @param[in] x abscissa of the position
+ * @param[in] y ordinate of the position
+ * @param[in] distance inclusive distance
+ * @return true if the position is inside the country or close to it
+ */
+bool country_is_near(country_t *country, double x, double y,
+                     double distance) {
+  limits_t *limits = &country->limits;
+  if (x < limits->xmin ? limits->xmin - x > distance
+                       : (x >= limits->xmax && x - limits->xmax > distance)) {
+    return false;
+  }
+  if (y < limits->ymin ? limits->ymin - y > distance
+                       : (y >= limits->ymax && y - limits->ymax > distance)) {
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "config.h"
+#include "exposure-engine.h"
+#include "individual.h"
+#include "population.h"
+#include "utils.h"
+#include "world.h"
+
+/* Sort a population when the mean distance between its individuals adjacent
+ * in memory grows by this factor since its last sort */
+#define LOCALITY_DEGRADATION 2.
+
+/* Most time spent sorting a population, as a fraction of the time spent by
+ * its exposure and motion since its last sort */
+#define LOCALITY_MAX_OVERHEAD 0.05
+
+/**
+ * @brief State of a single country, owned by exactly one process
+ *
+ * Countries are numbered in row-major order, starting from the south-west
+ * corner of the world.
+ */
+typedef struct country {
+  int id;                        /**< Index of the country in the world */
+  limits_t limits;               /**< Limits of the country */
+  int neighbors[NEIGHBOR_COUNT]; /**< Indices of the neighbor countries,
+                                    indexed by cardinal point, -1 if none */
+  population_t population;       /**< Individuals inside the country */
+  exposure_index_t infected_index; /**< Index where the infected individuals
+                                      are inserted */
+  double verlet_skin; /**< Distance added to the spreading one by the Verlet
+                         flags, 0 if not used */
+  unsigned long verlet_steps; /**< Steps the Verlet flags stay valid */
+  unsigned long verlet_age;   /**< Steps since the Verlet flags were
+                                 computed */
+  ghost_t *halo;        /**< Infected individuals of neighbor countries close
+                           to the border */
+  size_t halo_len;
+  size_t halo_capacity;
+  migrant_t *migrated_out[NEIGHBOR_COUNT]; /**< Individuals that left the
+                                              country, indexed by cardinal
+                                              point */
+  size_t migrated_out_len[NEIGHBOR_COUNT];
+  size_t migrated_out_capacity[NEIGHBOR_COUNT];
+  double cost; /**< Computation time (s) spent on the country since the last
+                  load balancing */
+  double locality;  /**< Locality of the population right after its last
+                       sort, as in population_locality(), 0 if never sorted */
+  double step_time; /**< Time (s) spent by the exposure and the motion of the
+                       individuals in the current step */
+  double sort_step_time; /**< Time (s) per individual of the step before the
+                            population was sorted, negative if it was not
+                            sorted at the end of the last step */
+  double sort_time; /**< Time (s) spent by the last sort */
+  double work_time; /**< Time (s) spent by the exposure and the motion of the
+                       individuals since the last sort */
+} country_t;
+
+/**
+ * @brief Statistics of the sorts of the populations of a process
+ */
+typedef struct locality_stats {
+  unsigned long sorts;    /**< Number of sorted populations */
+  unsigned long timed;    /**< Sorts followed by a step with individuals */
+  double sort_time;       /**< Time (s) spent sorting */
+  double locality_before; /**< Sum of the locality before each sort */
+  double locality_after;  /**< Sum of the locality after each sort */
+  double time_before; /**< Sum of the time (s) per individual of the step
+                         before each timed sort */
+  double time_after;  /**< Sum of the time (s) per individual of the step
+                         after each timed sort */
+} locality_stats_t;
+
+country_t create_country(global_config_t *cfg, int num_countries, int id);
+
+void free_country(country_t *country);
+
+limits_t calculate_country_limits(global_config_t *cfg, int num_countries,
+                                  int country);
+
+void calculate_neighbors(int neighbors[], global_config_t *cfg,
+                         int num_countries, int country);
+
+bool country_is_near(country_t *country, double x, double y,
+                     double distance);
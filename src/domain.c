@@ -0,0 +1,456 @@
+#include "domain.h"
+
+/**
+ * @brief Finds the other processes owning the neighbors of the local
+ * countries, and connects them with a graph communicator
+ *
+ * Must be called by all the processes, since the creation of the communicator
+ * is collective.
+ *
+ * @param[in,out] domain domain whose \c neighbor_ranks , \c neighbor_index
+ * and \c neighbor_comm are updated
+ */
+static void update_neighbor_ranks(domain_t *domain) {
+  /* Number of pairs of adjacent countries shared with each process */
+  int *links = calloc(domain->world_size, sizeof(int));
+  for (int k = 0; k < domain->num_local; k++) {
+    for (int i = 0; i < NEIGHBOR_COUNT; i++) {
+      int n = domain->countries[k].neighbors[i];
+      if (n >= 0 && domain->owner[n] != domain->rank) {
+        links[domain->owner[n]]++;
+      }
+    }
+  }
+  domain->num_neighbor_ranks = 0;
+  for (int r = 0; r < domain->world_size; r++) {
+    domain->neighbor_index[r] = -1;
+    if (links[r] > 0) {
+      domain->neighbor_index[r] = domain->num_neighbor_ranks;
+      /* Compact the links into the weights of the edges */
+      links[domain->num_neighbor_ranks] = links[r];
+      domain->neighbor_ranks[domain->num_neighbor_ranks++] = r;
+    }
+  }
+
+  /* Adjacency between countries is symmetric, so sources and destinations are
+   * the same processes, in the same order and with the same weights on both
+   * sides. The weights hint the relative traffic to the MPI library */
+  if (domain->neighbor_comm != MPI_COMM_NULL) {
+    MPI_Comm_free(&domain->neighbor_comm);
+  }
+  MPI_Dist_graph_create_adjacent(
+      domain->comm, domain->num_neighbor_ranks, domain->neighbor_ranks, links,
+      domain->num_neighbor_ranks, domain->neighbor_ranks, links, MPI_INFO_NULL,
+      0, &domain->neighbor_comm);
+  free(links);
+}
+
+/**
+ * @brief Chooses how to arrange the processes in a grid of blocks of countries
+ *
+ * Among the factorizations <tt>px * py</tt> of \p world_size that fit the grid
+ * of countries, the one that minimizes the total length of the borders between
+ * blocks is chosen.
+ *
+ * @param[in] cols number of columns of countries
+ * @param[in] rows number of rows of countries
+ * @param[in] world_size number of processes
+ * @param[out] px number of columns of processes, 0 if none fits
+ * @param[out] py number of rows of processes, 0 if none fits
+ */
+static void choose_process_grid(int cols, int rows, int world_size, int *px,
+                                int *py) {
+  long cost, best_cost = -1;
+  *px = *py = 0;
+  for (int x = 1; x <= world_size; x++) {
+    int y = world_size / x;
+    if (world_size % x != 0 || x > cols || y > rows) {
+      continue;
+    }
+    /* Length of the vertical and horizontal cuts, in countries */
+    cost = (long)(x - 1) * rows + (long)(y - 1) * cols;
+    if (best_cost < 0 || cost < best_cost) {
+      best_cost = cost;
+      *px = x;
+      *py = y;
+    }
+  }
+}
+
+/**
+ * @brief Calculates the position of a cell along a Hilbert curve
+ *
+ * @param[in] n side of the square covered by the curve, a power of 2
+ * @param[in] x column of the cell, lower than \p n
+ * @param[in] y row of the cell, lower than \p n
+ * @return unsigned long distance of the cell from the start of the curve
+ */
+static unsigned long hilbert_index(unsigned long n, unsigned long x,
+                                   unsigned long y) {
+  unsigned long rx, ry, tmp, d = 0;
+  for (unsigned long s = n / 2; s > 0; s /= 2) {
+    rx = (x & s) > 0;
+    ry = (y & s) > 0;
+    d += s * s * ((3 * rx) ^ ry);
+    /* Rotate the quadrant, so that the curve is continuous */
+    if (ry == 0) {
+      if (rx == 1) {
+        x = n - 1 - x;
+        y = n - 1 - y;
+      }
+      tmp = x;
+      x = y;
+      y = tmp;
+    }
+  }
+  return d;
+}
+
+/* Country with its position along the Hilbert curve, for sorting */
+typedef struct curve_item {
+  unsigned long index;
+  int country;
+} curve_item_t;
+
+static int compare_curve_items(const void *a, const void *b) {
+  const curve_item_t *ia = a, *ib = b;
+  return (ia->index > ib->index) - (ia->index < ib->index);
+}
+
+/**
+ * @brief Calculates the ratio between the maximum and the average load of the
+ * processes
+ *
+ * @param[in] num_countries number of countries
+ * @param[in] world_size number of processes
+ * @param[in] cost cost of each country
+ * @param[in] owner rank of the owner of each country
+ * @return double imbalance, at least 1 (0 if there is no cost at all)
+ */
+static double load_imbalance(int num_countries, int world_size,
+                             const double cost[], const int owner[]) {
+  double *load = calloc(world_size, sizeof(double));
+  double total = 0., max = 0.;
+  for (int c = 0; c < num_countries; c++) {
+    load[owner[c]] += cost[c];
+    total += cost[c];
+  }
+  for (int r = 0; r < world_size; r++) {
+    max = MAX(max, load[r]);
+  }
+  free(load);
+  return total > 0. ? max * world_size / total : 0.;
+}
+
+/**
+ * @brief Assigns the countries to the processes in rectangular blocks
+ *
+ * The processes are arranged in a <tt>px * py</tt> grid, choosing among the
+ * factorizations of \p world_size the one that minimizes the total length of
+ * the borders between blocks. Blocks differ by at most one row or column of
+ * countries. If no factorization fits the grid of countries, the countries are
+ * split in contiguous chunks in row-major order.
+ *
+ * @param[in] cols number of columns of countries
+ * @param[in] rows number of rows of countries
+ * @param[in] world_size number of processes, not greater than the number of
+ * countries
+ * @param[out] owner array of size <tt>cols * rows</tt> where the rank of the
+ * owner of each country is stored
+ */
+void partition_countries(int cols, int rows, int world_size, int owner[]) {
+  int px, py;
+  choose_process_grid(cols, rows, world_size, &px, &py);
+
+  for (int row = 0; row < rows; row++) {
+    for (int col = 0; col < cols; col++) {
+      int country = row * cols + col;
+      if (px > 0) {
+        owner[country] = (row * py / rows) * px + (col * px / cols);
+      } else {
+        owner[country] = (long)country * world_size / (cols * rows);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Creates the domain of a process, with empty countries
+ *
+ * The processes are arranged in a cartesian communicator matching the blocks
+ * of \c partition_countries() , letting MPI reorder them so that processes
+ * owning adjacent blocks are placed close to each other. Must be called by all
+ * the processes.
+ *
+ * @param[in] cfg global configuration
+ * @param[in] comm communicator of all the processes
+ * @return domain_t
+ */
+domain_t create_domain(global_config_t *cfg, MPI_Comm comm) {
+  domain_t domain;
+  const int cols = (cfg->world_w / cfg->country_w);
+  const int rows = (cfg->world_l / cfg->country_l);
+  int world_size, px, py;
+  MPI_Comm_size(comm, &world_size);
+
+  /* Rows of processes first, so that the rank of the block in row py_i and
+   * column px_i is py_i * px + px_i, as in partition_countries(). Without a
+   * grid, the chunks of countries are a line of processes */
+  choose_process_grid(cols, rows, world_size, &px, &py);
+  int dims[2] = {py > 0 ? py : world_size, px > 0 ? px : 1};
+  int periods[2] = {0, 0};
+  MPI_Cart_create(comm, 2, dims, periods, 1, &domain.comm);
+  MPI_Comm_rank(domain.comm, &domain.rank);
+  domain.world_size = world_size;
+  domain.num_countries = cols * rows;
+  domain.owner = malloc(domain.num_countries * sizeof(int));
+  domain.local_index = malloc(domain.num_countries * sizeof(int));
+  domain.neighbor_ranks = malloc(world_size * sizeof(int));
+  domain.neighbor_index = malloc(world_size * sizeof(int));
+  domain.neighbor_comm = MPI_COMM_NULL;
+  partition_countries(cols, rows, world_size, domain.owner);
+  const int rank = domain.rank;
+
+  /* Create the local countries */
+  domain.num_local = 0;
+  for (int c = 0; c < domain.num_countries; c++) {
+    domain.local_index[c] = domain.owner[c] == rank ? domain.num_local++ : -1;
+  }
+  domain.countries = malloc(domain.num_local * sizeof(country_t));
+  for (int c = 0; c < domain.num_countries; c++) {
+    if (domain.local_index[c] >= 0) {
+      domain.countries[domain.local_index[c]] =
+          create_country(cfg, domain.num_countries, c);
+    }
+  }
+
+  update_neighbor_ranks(&domain);
+  return domain;
+}
+
+/**
+ * @brief Frees the dynamically allocated buffers of a domain and its countries
+ *
+ * @param[in,out] domain
+ */
+void free_domain(domain_t *domain) {
+  for (int k = 0; k < domain->num_local; k++) {
+    free_country(&domain->countries[k]);
+  }
+  free(domain->countries);
+  free(domain->owner);
+  free(domain->local_index);
+  free(domain->neighbor_ranks);
+  free(domain->neighbor_index);
+  MPI_Comm_free(&domain->neighbor_comm);
+  MPI_Comm_free(&domain->comm);
+}
+
+/**
+ * @brief Assigns the countries to the processes so that each one gets about
+ * the same cost
+ *
+ * The countries are ordered along a Hilbert curve, which keeps close
+ * countries close in the order, and the order is split into \p world_size
+ * contiguous parts with about the same total cost. Each part gets at least one
+ * country.
+ *
+ * @param[in] cols number of columns of countries
+ * @param[in] rows number of rows of countries
+ * @param[in] world_size number of processes, not greater than the number of
+ * countries
+ * @param[in] cost non-negative cost of each country
+ * @param[out] owner array of size <tt>cols * rows</tt> where the rank of the
+ * owner of each country is stored
+ */
+void partition_countries_by_cost(int cols, int rows, int world_size,
+                                 const double cost[], int owner[]) {
+  const int num_countries = cols * rows;
+  curve_item_t *curve = malloc(num_countries * sizeof(curve_item_t));
+  unsigned long side = 1;
+  while (side < cols || side < rows) {
+    side *= 2;
+  }
+  double total = 0.;
+  for (int c = 0; c < num_countries; c++) {
+    curve[c].index = hilbert_index(side, c % cols, c / cols);
+    curve[c].country = c;
+    total += cost[c];
+  }
+  qsort(curve, num_countries, sizeof(curve_item_t), compare_curve_items);
+
+  double cumulated = 0.;
+  int part = 0, part_len = 0, following_parts, c;
+  for (int k = 0; k < num_countries; k++) {
+    c = curve[k].country;
+    following_parts = world_size - 1 - part;
+    /* Start the next part if the country falls mostly beyond the share of the
+     * current one, or if the following parts need all the remaining ones */
+    if (following_parts > 0 && part_len > 0 &&
+        (cumulated + cost[c] / 2 > total * (part + 1) / world_size ||
+         num_countries - k == following_parts)) {
+      part++;
+      part_len = 0;
+    }
+    owner[c] = part;
+    part_len++;
+    cumulated += cost[c];
+  }
+  free(curve);
+}
+
+/**
+ * @brief Reassigns the countries to the processes according to their cost,
+ * and moves the populations of the reassigned countries to the new owners
+ *
+ * The cost of each country measured since the last call is shared with all
+ * the processes, which compute the same assignment with \c
+ * partition_countries_by_cost() . It is adopted only if the current load
+ * imbalance exceeds \c BALANCE_THRESHOLD , and the new one is lower by the
+ * same factor, so that noise in the measures does not move countries back and
+ * forth. The
+ * individuals of the reassigned countries are exchanged with a single \c
+ * MPI_Alltoallv , packed by ascending country.
+ *
+ * Must be called by all the processes between two steps, when the halo and
+ * outbound buffers of the countries are empty.
+ *
+ * @param[in,out] domain domain of this process
+ * @param[in] cfg global configuration
+ * @param[in] t time of the next step
+ * @param[in] mpi_individual custom MPI datatype for sending individual_t
+ * @return int number of reassigned countries
+ */
+int balance_domain(domain_t *domain, global_config_t *cfg, unsigned long t,
+                   MPI_Datatype mpi_individual) {
+  const int num_countries = domain->num_countries;
+  const int world_size = domain->world_size;
+  const int rank = domain->rank;
+  country_t *country;
+
+  /* Share the cost and the population size of each country */
+  double *cost = calloc(num_countries, sizeof(double));
+  unsigned long *len = calloc(num_countries, sizeof(unsigned long));
+  for (int k = 0; k < domain->num_local; k++) {
+    country = &domain->countries[k];
+    cost[country->id] = country->cost;
+    len[country->id] = country->population.len;
+    country->cost = 0.;
+  }
+  MPI_Allreduce(MPI_IN_PLACE, cost, num_countries, MPI_DOUBLE, MPI_SUM,
+                domain->comm);
+  MPI_Allreduce(MPI_IN_PLACE, len, num_countries, MPI_UNSIGNED_LONG, MPI_SUM,
+                domain->comm);
+
+  /* Compute the new assignment, identical on all processes */
+  int *owner = malloc(num_countries * sizeof(int));
+  partition_countries_by_cost(cfg->world_w / cfg->country_w,
+                              cfg->world_l / cfg->country_l, world_size, cost,
+                              owner);
+  double imbalance =
+      load_imbalance(num_countries, world_size, cost, domain->owner);
+  double new_imbalance = load_imbalance(num_countries, world_size, cost, owner);
+  if (imbalance < BALANCE_THRESHOLD ||
+      new_imbalance * BALANCE_THRESHOLD > imbalance) {
+    free(cost);
+    free(len);
+    free(owner);
+    return 0;
+  }
+
+  /* Count the individuals to be exchanged with each process */
+  int *send_counts = calloc(world_size, sizeof(int));
+  int *recv_counts = calloc(world_size, sizeof(int));
+  int *send_displs = malloc(world_size * sizeof(int));
+  int *recv_displs = malloc(world_size * sizeof(int));
+  int moved = 0;
+  for (int c = 0; c < num_countries; c++) {
+    if (owner[c] == domain->owner[c]) {
+      continue;
+    }
+    moved++;
+    if (domain->owner[c] == rank) {
+      send_counts[owner[c]] += len[c];
+    } else if (owner[c] == rank) {
+      recv_counts[domain->owner[c]] += len[c];
+    }
+  }
+  int send_total = 0, recv_total = 0;
+  for (int r = 0; r < world_size; r++) {
+    send_displs[r] = send_total;
+    recv_displs[r] = recv_total;
+    send_total += send_counts[r];
+    recv_total += recv_counts[r];
+  }
+
+  /* Pack the leaving populations by ascending country */
+  individual_t *send_buf = malloc(send_total * sizeof(individual_t));
+  individual_t *recv_buf = malloc(recv_total * sizeof(individual_t));
+  int *cursor = malloc(world_size * sizeof(int));
+  memcpy(cursor, send_displs, world_size * sizeof(int));
+  for (int c = 0; c < num_countries; c++) {
+    if (domain->owner[c] == rank && owner[c] != rank) {
+      country = &domain->countries[domain->local_index[c]];
+      for (size_t i = 0; i < country->population.len; i++) {
+        population_get(&country->population, i,
+                       &send_buf[cursor[owner[c]]++]);
+      }
+    }
+  }
+  MPI_Alltoallv(send_buf, send_counts, send_displs, mpi_individual, recv_buf,
+                recv_counts, recv_displs, mpi_individual, domain->comm);
+
+  /* Keep the countries that stay, create the arriving ones and free the
+   * leaving ones */
+  int num_local = 0;
+  for (int c = 0; c < num_countries; c++) {
+    num_local += owner[c] == rank;
+  }
+  country_t *countries = malloc(num_local * sizeof(country_t));
+  memcpy(cursor, recv_displs, world_size * sizeof(int));
+  num_local = 0;
+  for (int c = 0; c < num_countries; c++) {
+    if (owner[c] == rank) {
+      if (domain->local_index[c] >= 0) {
+        countries[num_local] = domain->countries[domain->local_index[c]];
+      } else {
+        countries[num_local] = create_country(cfg, num_countries, c);
+        country = &countries[num_local];
+        country->population.t = t;
+        population_reserve(&country->population, len[c]);
+        for (unsigned long i = 0; i < len[c]; i++) {
+          population_insert(&country->population,
+                            &recv_buf[cursor[domain->owner[c]]++]);
+        }
+      }
+      domain->local_index[c] = num_local++;
+    } else {
+      if (domain->local_index[c] >= 0) {
+        free_country(&domain->countries[domain->local_index[c]]);
+      }
+      domain->local_index[c] = -1;
+    }
+  }
+  free(domain->countries);
+  domain->countries = countries;
+  domain->num_local = num_local;
+  memcpy(domain->owner, owner, num_countries * sizeof(int));
+  update_neighbor_ranks(domain);
+
+  if (rank == ROOT_RANK) {
+    log_info("Load imbalance %.2f -> %.2f: %d countries reassigned", imbalance,
+             new_imbalance, moved);
+  }
+
+  free(cost);
+  free(len);
+  free(owner);
+  free(send_counts);
+  free(recv_counts);
+  free(send_displs);
+  free(recv_displs);
+  free(send_buf);
+  free(recv_buf);
+  free(cursor);
+  return moved;
+}
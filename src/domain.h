@@ -0,0 +1,55 @@
+#pragma once
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "country.h"
+#include "utils.h"
+#include "world.h"
+
+/* Minimum ratio between the maximum and the average load of the processes for
+ * the countries to be reassigned, and minimum improvement factor */
+#define BALANCE_THRESHOLD 1.1
+
+/**
+ * @brief Countries owned by a process and the processes it must communicate
+ * with
+ *
+ * Each country of the world is owned by exactly one process, while a process
+ * can own any number of countries.
+ */
+typedef struct domain {
+  int rank;             /**< Rank of this process */
+  int world_size;       /**< Number of processes */
+  int num_countries;    /**< Number of countries in the world */
+  int *owner;           /**< Rank owning each country of the world */
+  int *local_index;     /**< Index in \c countries of each country of the
+                           world, -1 if owned by another process */
+  country_t *countries; /**< Countries owned by this process, by ascending id */
+  int num_local;        /**< Number of countries owned by this process */
+  int *neighbor_ranks;  /**< Other processes owning countries adjacent to the
+                           local ones, in ascending order */
+  int num_neighbor_ranks;
+  int *neighbor_index;  /**< Index in \c neighbor_ranks of each process, -1 if
+                           not a neighbor */
+  MPI_Comm comm;        /**< Cartesian communicator of the processes, whose
+                           ranks are used throughout */
+  MPI_Comm neighbor_comm; /**< Graph communicator connecting each process to
+                             its neighbor processes, in the same order as \c
+                             neighbor_ranks */
+} domain_t;
+
+void partition_countries(int cols, int rows, int world_size, int owner[]);
+
+void partition_countries_by_cost(int cols, int rows, int world_size,
+                                 const double cost[], int owner[]);
+
+domain_t create_domain(global_config_t *cfg, MPI_Comm comm);
+
+void free_domain(domain_t *domain);
+
+int balance_domain(domain_t *domain, global_config_t *cfg, unsigned long t,
+                   MPI_Datatype mpi_individual);
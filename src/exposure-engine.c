@@ -0,0 +1,353 @@
+#include "exposure-engine.h"
+
+/**
+ * @brief Creates an empty exposure index
+ *
+ * The grid is always created, since an automatic index starts from it.
+ *
+ * @param[in] limits rectangle covered by the grid
+ * @param[in] margin distance by which the rectangle is enlarged on each side
+ * @param[in] cell_size minimum side of a cell, not lower than the distances
+ * of the queries
+ * @param[in] engine as in exposure_engine_t, not \c EXPOSURE_KDTREE if \p
+ * swept
+ * @param[in] swept whether swept queries are made
+ * @return exposure_index_t
+ */
+exposure_index_t create_exposure_index(limits_t *limits, double margin,
+                                       double cell_size, int engine,
+                                       bool swept) {
+  exposure_index_t index;
+  index.tune = engine == EXPOSURE_AUTO;
+  index.swept = swept;
+  index.engine = index.tune ? EXPOSURE_GRID : engine;
+  index.trial = -1;
+  index.steps = 0;
+  for (int e = 0; e < EXPOSURE_ENGINE_COUNT; e++) {
+    index.time[e] = 0.;
+  }
+  index.grid = create_grid(limits, margin, cell_size);
+  index.pos_x = index.pos_y = index.displ_x = index.displ_y = NULL;
+  index.len = index.capacity = 0;
+  return index;
+}
+
+/**
+ * @brief Frees the dynamically allocated buffers of an exposure index
+ *
+ * @param[in,out] index
+ */
+void free_exposure_index(exposure_index_t *index) {
+  free_grid(&index->grid);
+  free(index->pos_x);
+  free(index->pos_y);
+  free(index->displ_x);
+  free(index->displ_y);
+}
+
+/**
+ * @brief Marks the start of a step, choosing the engine of an automatic index
+ *
+ * The first steps of each tuning period are trials, one for each engine; the
+ * brute force is not tried if the last step had too many positions, nor the
+ * 2-d tree for swept queries. The fastest engine is then kept until the next
+ * tuning.
+ *
+ * @param[in,out] index
+ */
+void exposure_index_step(exposure_index_t *index) {
+  const unsigned long phase = index->steps++ % EXPOSURE_TUNE_EVERY;
+  index->trial = -1;
+  if (!index->tune) {
+    return;
+  }
+  if (phase < EXPOSURE_ENGINE_COUNT) {
+    if ((phase == EXPOSURE_BRUTE && index->len > EXPOSURE_BRUTE_MAX) ||
+        (phase == EXPOSURE_KDTREE && index->swept)) {
+      index->time[phase] = INFINITY;
+    } else {
+      index->trial = index->engine = phase;
+      index->time[phase] = 0.;
+    }
+  } else if (phase == EXPOSURE_ENGINE_COUNT) {
+    for (int e = 0; e < EXPOSURE_ENGINE_COUNT; e++) {
+      if (index->time[e] < index->time[index->engine]) {
+        index->engine = e;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Records the time spent using an index in the current step
+ *
+ * @param[in,out] index
+ * @param[in] time time in seconds
+ */
+void exposure_index_account(exposure_index_t *index, double time) {
+  if (index->trial >= 0) {
+    index->time[index->trial] += time;
+  }
+}
+
+/**
+ * @brief Removes all the positions from an index
+ *
+ * @param[in,out] index
+ */
+void exposure_index_reset(exposure_index_t *index) { index->len = 0; }
+
+/**
+ * @brief Inserts a position into an index
+ *
+ * The position is not visible to queries until \c exposure_index_build() is
+ * called.
+ *
+ * @param[in,out] index
+ * @param[in] x abscissa of the position
+ * @param[in] y ordinate of the position
+ * @param[in] dx displacement along x in the step
+ * @param[in] dy displacement along y in the step
+ */
+void exposure_index_insert(exposure_index_t *index, double x, double y,
+                           double dx, double dy) {
+  if (index->len >= index->capacity) {
+    index->capacity += DYN_ARRAY_CHUNK;
+    index->pos_x = realloc(index->pos_x, index->capacity * sizeof(double));
+    index->pos_y = realloc(index->pos_y, index->capacity * sizeof(double));
+    index->displ_x = realloc(index->displ_x, index->capacity * sizeof(double));
+    index->displ_y = realloc(index->displ_y, index->capacity * sizeof(double));
+  }
+  index->pos_x[index->len] = x;
+  index->pos_y[index->len] = y;
+  index->displ_x[index->len] = dx;
+  index->displ_y[index->len] = dy;
+  index->len++;
+}
+
+/**
+ * @brief Prepares the structure of the engine in use for the inserted
+ * positions, making them visible to queries
+ *
+ * @param[in,out] index
+ */
+void exposure_index_build(exposure_index_t *index) {
+  switch (index->engine) {
+    case EXPOSURE_GRID: {
+      grid_reset(&index->grid);
+      for (size_t k = 0; k < index->len; k++) {
+        grid_insert(&index->grid, index->pos_x[k], index->pos_y[k]);
+      }
+      grid_sort(&index->grid);
+      break;
+    }
+    case EXPOSURE_KDTREE: {
+      kdtree_build(index->pos_x, index->pos_y, index->len);
+      break;
+    }
+    default: /* The brute force scans the positions as inserted */
+      break;
+  }
+}
+
+/**
+ * @brief Checks whether any position of an index lies within a distance from
+ * a point
+ *
+ * @param[in] index
+ * @param[in] x abscissa of the point
+ * @param[in] y ordinate of the point
+ * @param[in] distance inclusive distance, not greater than the cell size of
+ * the index
+ * @return true if at least one position is found
+ */
+bool exposure_index_any_within(exposure_index_t *index, double x, double y,
+                               double distance) {
+  switch (index->engine) {
+    case EXPOSURE_GRID:
+      return grid_any_within(&index->grid, x, y, distance);
+    case EXPOSURE_KDTREE:
+      return kdtree_any_within(index->pos_x, index->pos_y, index->len, x, y,
+                               distance);
+    default:
+      return any_within(index->pos_x, index->pos_y, index->len, x, y,
+                        distance * distance);
+  }
+}
+
+/**
+ * @brief Interval of a step, as fractions of its duration
+ */
+typedef struct interval {
+  double begin, end;
+} interval_t;
+
+/**
+ * @brief Computes the part of a step during which two points moving linearly
+ * are within a distance
+ *
+ * The squared distance along the step is a quadratic function of time, whose
+ * roots bound the interval.
+ *
+ * @param[in] rx abscissa of the second point relative to the first one, at
+ * the start of the step
+ * @param[in] ry ordinate of the second point relative to the first one, at
+ * the start of the step
+ * @param[in] wx displacement along x of the second point relative to the first
+ * one
+ * @param[in] wy displacement along y of the second point relative to the first
+ * one
+ * @param[in] distance_sq square of the inclusive distance
+ * @param[out] interval where the part of the step is stored
+ * @return true if the part is not empty
+ */
+static bool closest_approach(double rx, double ry, double wx, double wy,
+                             double distance_sq, interval_t *interval) {
+  const double a = wx * wx + wy * wy;
+  const double b = rx * wx + ry * wy;
+  const double c = rx * rx + ry * ry - distance_sq;
+  if (a == 0.) {
+    /* Not moving apart: in range for the whole step or never */
+    interval->begin = 0.;
+    interval->end = 1.;
+    return c <= 0.;
+  }
+  const double disc = b * b - a * c;
+  if (disc < 0.) {
+    return false;
+  }
+  const double root = sqrt(disc);
+  interval->begin = MAX((-b - root) / a, 0.);
+  interval->end = MIN((-b + root) / a, 1.);
+  return interval->begin <= interval->end;
+}
+
+/**
+ * @brief Adds an interval to a set of disjoint intervals sorted by start
+ *
+ * The overlapping intervals are merged. If the set is full, the new interval
+ * is joined to the closest one instead, which overestimates their union.
+ *
+ * @param[in,out] set intervals, with room for \c EXPOSURE_MAX_INTERVALS
+ * @param[in,out] len number of intervals in the set
+ * @param[in] interval interval to be added
+ */
+static void add_interval(interval_t set[], int *len, interval_t interval) {
+  int k = 0, m;
+  /* Skip the intervals ending before it, then absorb the overlapping ones */
+  while (k < *len && set[k].end < interval.begin) {
+    k++;
+  }
+  for (m = k; m < *len && set[m].begin <= interval.end; m++) {
+    interval.begin = MIN(interval.begin, set[m].begin);
+    interval.end = MAX(interval.end, set[m].end);
+  }
+  if (m == k && *len == EXPOSURE_MAX_INTERVALS) {
+    /* Disjoint from all in a full set */
+    if (k == *len || (k > 0 && interval.begin - set[k - 1].end <
+                                   set[k].begin - interval.end)) {
+      set[k - 1].end = interval.end;
+    } else {
+      set[k].begin = interval.begin;
+    }
+    return;
+  }
+  /* Replace the absorbed intervals [k, m) with the new one */
+  memmove(&set[k + 1], &set[m], (*len - m) * sizeof(interval_t));
+  set[k] = interval;
+  *len += 1 - (m - k);
+}
+
+/**
+ * @brief Computes the part of a step during which a moving point is within a
+ * distance from any position moving by its displacement
+ *
+ * Each position and the point are assumed to move linearly along the step,
+ * ignoring the bounces at the edges of the world. With the grid, the
+ * distance plus the largest relative displacement must not exceed the cell
+ * size of the index.
+ *
+ * @param[in] index built index, not using \c EXPOSURE_KDTREE
+ * @param[in] x abscissa of the point at the start of the step
+ * @param[in] y ordinate of the point at the start of the step
+ * @param[in] dx displacement along x of the point in the step
+ * @param[in] dy displacement along y of the point in the step
+ * @param[in] distance inclusive distance
+ * @return double fraction of the step, in [0, 1]
+ */
+double exposure_index_time_within(exposure_index_t *index, double x, double y,
+                                  double dx, double dy, double distance) {
+  const double distance_sq = distance * distance;
+  interval_t set[EXPOSURE_MAX_INTERVALS], interval;
+  int len = 0;
+  /* Ranges of the positions to be checked, with their insertion indices */
+  size_t begin[3], end[3], n = 0;
+  const size_t *item_index = NULL;
+  const double *pos_x = index->pos_x, *pos_y = index->pos_y;
+
+  if (index->engine == EXPOSURE_GRID) {
+    grid_t *grid = &index->grid;
+    long col = grid_cell_col(grid, x);
+    long row = grid_cell_row(grid, y);
+    for (long r = MAX(row - 1, 0); r <= MIN(row + 1, grid->rows - 1); r++) {
+      begin[n] = grid->cell_start[r * grid->cols + MAX(col - 1, 0)];
+      end[n] =
+          grid->cell_start[r * grid->cols + MIN(col + 1, grid->cols - 1) + 1];
+      n++;
+    }
+    item_index = grid->item_index;
+    pos_x = grid->pos_x;
+    pos_y = grid->pos_y;
+  } else {
+    begin[0] = 0;
+    end[0] = index->len;
+    n = 1;
+  }
+
+  for (size_t r = 0; r < n; r++) {
+    for (size_t k = begin[r]; k < end[r]; k++) {
+      size_t j = item_index ? item_index[k] : k;
+      if (closest_approach(pos_x[k] - x, pos_y[k] - y,
+                           index->displ_x[j] - dx, index->displ_y[j] - dy,
+                           distance_sq, &interval)) {
+        add_interval(set, &len, interval);
+        /* Nothing more can be added to the whole step */
+        if (set[0].begin == 0. && set[0].end == 1.) {
+          return 1.;
+        }
+      }
+    }
+  }
+
+  double within = 0.;
+  for (int k = 0; k < len; k++) {
+    within += set[k].end - set[k].begin;
+  }
+  return within;
+}
+
+/**
+ * @brief Decodes the name of an exposure engine
+ *
+ * @param[in] arg name of the engine, case-insensitive, not null
+ * @return int engine, as in exposure_engine_t, -1 if unknown
+ */
+int decode_exposure_engine(char *arg) {
+  for (int e = 0; e <= EXPOSURE_AUTO; e++) {
+    if (strcasecmp(arg, exposure_engine_string(e)) == 0) {
+      return e;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Returns the name of an exposure engine
+ *
+ * @param[in] engine as in exposure_engine_t
+ * @return const char* name of the engine
+ */
+const char *exposure_engine_string(int engine) {
+  static const char *names[] = {"brute", "grid", "kdtree", "auto"};
+  return engine >= 0 && engine <= EXPOSURE_AUTO ? names[engine] : "unknown";
+}
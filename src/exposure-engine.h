@@ -0,0 +1,98 @@
+#pragma once
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "exposure-kernel.h"
+#include "grid.h"
+#include "kdtree.h"
+#include "utils.h"
+#include "world.h"
+
+/* Steps between two tunings of an automatic exposure index */
+#define EXPOSURE_TUNE_EVERY 200
+
+/* Largest number of positions for which the brute force engine is tuned */
+#define EXPOSURE_BRUTE_MAX 512
+
+/* Most disjoint intervals of a step tracked by a swept query, beyond which
+ * the closest ones are joined */
+#define EXPOSURE_MAX_INTERVALS 8
+
+/**
+ * @brief Algorithm answering the queries of an exposure index
+ */
+typedef enum exposure_engine {
+  EXPOSURE_BRUTE,  /**< Scan all the positions */
+  EXPOSURE_GRID,   /**< Uniform grid of cells */
+  EXPOSURE_KDTREE, /**< 2-d tree */
+  EXPOSURE_AUTO    /**< Time the others periodically and use the fastest */
+} exposure_engine_t;
+
+/* Number of engines that answer the queries, i.e. all but EXPOSURE_AUTO */
+#define EXPOSURE_ENGINE_COUNT EXPOSURE_AUTO
+
+/**
+ * @brief Set of positions that answers whether any of them lies within a
+ * distance from a point
+ *
+ * The index is filled by calling \c exposure_index_reset() , then \c
+ * exposure_index_insert() for each position and finally \c
+ * exposure_index_build() , which prepares the structure of the engine in use.
+ * All the engines give the same answers, as they compare the same distances
+ * with the \c any_within kernel.
+ *
+ * Each position also has the displacement it will cover in the step, so that
+ * swept queries can follow it along the step. These are not answered by the
+ * 2-d tree, whose building does not keep the displacements aligned.
+ *
+ * An automatic index runs each engine for a step every \c
+ * EXPOSURE_TUNE_EVERY steps, and then keeps the fastest one. The steps are
+ * marked by \c exposure_index_step() , and timed by the caller with \c
+ * exposure_index_account() .
+ */
+typedef struct exposure_index {
+  int engine;            /**< Engine in use, as in exposure_engine_t */
+  bool tune;             /**< Whether the engine is chosen by timing */
+  bool swept;            /**< Whether swept queries are made */
+  int trial;             /**< Engine timed in this step, -1 if none */
+  unsigned long steps;   /**< Steps since the index was created */
+  double time[EXPOSURE_ENGINE_COUNT]; /**< Time of each engine in the last
+                                         tuning */
+  grid_t grid;               /**< Grid of the positions, for EXPOSURE_GRID */
+  double *pos_x, *pos_y;     /**< Inserted positions, arranged as a tree for
+                                EXPOSURE_KDTREE */
+  double *displ_x, *displ_y; /**< Displacement of the inserted positions */
+  size_t len;                /**< Number of positions */
+  size_t capacity;           /**< Capacity of the position arrays */
+} exposure_index_t;
+
+exposure_index_t create_exposure_index(limits_t *limits, double margin,
+                                       double cell_size, int engine,
+                                       bool swept);
+
+void free_exposure_index(exposure_index_t *index);
+
+void exposure_index_step(exposure_index_t *index);
+
+void exposure_index_account(exposure_index_t *index, double time);
+
+void exposure_index_reset(exposure_index_t *index);
+
+void exposure_index_insert(exposure_index_t *index, double x, double y,
+                           double dx, double dy);
+
+void exposure_index_build(exposure_index_t *index);
+
+bool exposure_index_any_within(exposure_index_t *index, double x, double y,
+                               double distance);
+
+double exposure_index_time_within(exposure_index_t *index, double x, double y,
+                                  double dx, double dy, double distance);
+
+int decode_exposure_engine(char *arg);
+
+const char *exposure_engine_string(int engine);
@@ -0,0 +1,156 @@
+#include "exposure-kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
+
+/*
+ * NOTE: This file must be compiled without floating-point contraction
+ * (-ffp-contract=off), otherwise the compiler may fuse the multiplications and
+ * additions of some kernels into FMAs, whose different rounding would make the
+ * result depend on the CPU.
+ */
+
+any_within_fn_t any_within = any_within_scalar;
+
+/**
+ * @brief Portable implementation of \c any_within_fn_t , one pair at a time
+ */
+bool any_within_scalar(const double *pos_x, const double *pos_y, size_t len,
+                       double x, double y, double distance_sq) {
+  double dx, dy;
+  for (size_t k = 0; k < len; k++) {
+    dx = pos_x[k] - x;
+    dy = pos_y[k] - y;
+    if (dx * dx + dy * dy <= distance_sq) {
+      return true;
+    }
+  }
+  return false;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/**
+ * @brief AVX2 implementation of \c any_within_fn_t , in blocks of 8 and 4
+ * positions
+ */
+__attribute__((target("avx2"))) static bool any_within_avx2(
+    const double *pos_x, const double *pos_y, size_t len, double x, double y,
+    double distance_sq) {
+  const __m256d vx = _mm256_set1_pd(x);
+  const __m256d vy = _mm256_set1_pd(y);
+  const __m256d vd = _mm256_set1_pd(distance_sq);
+  __m256d dx0, dy0, dx1, dy1, d0, d1;
+  size_t k = 0;
+  /* Two vectors per iteration, with a single branch */
+  for (; k + 8 <= len; k += 8) {
+    dx0 = _mm256_sub_pd(_mm256_loadu_pd(pos_x + k), vx);
+    dy0 = _mm256_sub_pd(_mm256_loadu_pd(pos_y + k), vy);
+    dx1 = _mm256_sub_pd(_mm256_loadu_pd(pos_x + k + 4), vx);
+    dy1 = _mm256_sub_pd(_mm256_loadu_pd(pos_y + k + 4), vy);
+    d0 = _mm256_add_pd(_mm256_mul_pd(dx0, dx0), _mm256_mul_pd(dy0, dy0));
+    d1 = _mm256_add_pd(_mm256_mul_pd(dx1, dx1), _mm256_mul_pd(dy1, dy1));
+    if (_mm256_movemask_pd(_mm256_or_pd(_mm256_cmp_pd(d0, vd, _CMP_LE_OQ),
+                                        _mm256_cmp_pd(d1, vd, _CMP_LE_OQ)))) {
+      return true;
+    }
+  }
+  /* Remaining block of 4 */
+  if (k + 4 <= len) {
+    dx0 = _mm256_sub_pd(_mm256_loadu_pd(pos_x + k), vx);
+    dy0 = _mm256_sub_pd(_mm256_loadu_pd(pos_y + k), vy);
+    d0 = _mm256_add_pd(_mm256_mul_pd(dx0, dx0), _mm256_mul_pd(dy0, dy0));
+    if (_mm256_movemask_pd(_mm256_cmp_pd(d0, vd, _CMP_LE_OQ))) {
+      return true;
+    }
+    k += 4;
+  }
+  /* Remaining positions */
+  return any_within_scalar(pos_x + k, pos_y + k, len - k, x, y, distance_sq);
+}
+
+/**
+ * @brief AVX-512 implementation of \c any_within_fn_t , in blocks of 16 and 8
+ * positions, with a masked tail
+ */
+__attribute__((target("avx512f"))) static bool any_within_avx512(
+    const double *pos_x, const double *pos_y, size_t len, double x, double y,
+    double distance_sq) {
+  const __m512d vx = _mm512_set1_pd(x);
+  const __m512d vy = _mm512_set1_pd(y);
+  const __m512d vd = _mm512_set1_pd(distance_sq);
+  __m512d dx0, dy0, dx1, dy1, d0, d1;
+  __mmask8 tail;
+  size_t k = 0;
+  /* Two vectors per iteration, with a single branch */
+  for (; k + 16 <= len; k += 16) {
+    dx0 = _mm512_sub_pd(_mm512_loadu_pd(pos_x + k), vx);
+    dy0 = _mm512_sub_pd(_mm512_loadu_pd(pos_y + k), vy);
+    dx1 = _mm512_sub_pd(_mm512_loadu_pd(pos_x + k + 8), vx);
+    dy1 = _mm512_sub_pd(_mm512_loadu_pd(pos_y + k + 8), vy);
+    d0 = _mm512_add_pd(_mm512_mul_pd(dx0, dx0), _mm512_mul_pd(dy0, dy0));
+    d1 = _mm512_add_pd(_mm512_mul_pd(dx1, dx1), _mm512_mul_pd(dy1, dy1));
+    if (_mm512_cmp_pd_mask(d0, vd, _CMP_LE_OQ) |
+        _mm512_cmp_pd_mask(d1, vd, _CMP_LE_OQ)) {
+      return true;
+    }
+  }
+  /* Remaining positions, in blocks of 8 with the last one masked */
+  for (; k < len; k += 8) {
+    tail = len - k >= 8 ? 0xFF : (1 << (len - k)) - 1;
+    dx0 = _mm512_sub_pd(_mm512_maskz_loadu_pd(tail, pos_x + k), vx);
+    dy0 = _mm512_sub_pd(_mm512_maskz_loadu_pd(tail, pos_y + k), vy);
+    d0 = _mm512_add_pd(_mm512_mul_pd(dx0, dx0), _mm512_mul_pd(dy0, dy0));
+    if (_mm512_mask_cmp_pd_mask(tail, d0, vd, _CMP_LE_OQ)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+#endif
+
+/**
+ * @brief Finds an implementation of \c any_within_fn_t by name
+ *
+ * @param[in] name "scalar", "avx2" or "avx512"
+ * @return any_within_fn_t the implementation, NULL if unknown, not compiled
+ * or not supported by the running CPU
+ */
+any_within_fn_t find_exposure_kernel(const char *name) {
+  if (strcmp(name, "scalar") == 0) {
+    return any_within_scalar;
+  }
+#ifdef HAVE_X86_KERNELS
+  __builtin_cpu_init();
+  if (strcmp(name, "avx512") == 0 && __builtin_cpu_supports("avx512f")) {
+    return any_within_avx512;
+  }
+  if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+    return any_within_avx2;
+  }
+#endif
+  return NULL;
+}
+
+/**
+ * @brief Selects the best implementation of \c any_within for the running CPU
+ *
+ * All the implementations compare squared distances with the same operations
+ * and rounding, so they find exactly the same positions.
+ *
+ * @return const char* name of the selected implementation
+ */
+const char *init_exposure_kernel() {
+  static const char *names[] = {"avx512", "avx2", "scalar"};
+  for (size_t k = 0; k < sizeof(names) / sizeof(names[0]); k++) {
+    any_within_fn_t kernel = find_exposure_kernel(names[k]);
+    if (kernel != NULL) {
+      any_within = kernel;
+      return names[k];
+    }
+  }
+  return "scalar";
+}
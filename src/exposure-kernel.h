@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Checks whether any of the given positions lies within a distance from
+ * a point
+ *
+ * @param[in] pos_x abscissae of the positions
+ * @param[in] pos_y ordinates of the positions
+ * @param[in] len number of positions
+ * @param[in] x abscissa of the point
+ * @param[in] y ordinate of the point
+ * @param[in] distance_sq square of the inclusive distance
+ * @return true if at least one position is found
+ */
+typedef bool (*any_within_fn_t)(const double *pos_x, const double *pos_y,
+                                size_t len, double x, double y,
+                                double distance_sq);
+
+/* Best implementation for the running CPU, set by init_exposure_kernel() */
+extern any_within_fn_t any_within;
+
+const char *init_exposure_kernel();
+
+any_within_fn_t find_exposure_kernel(const char *name);
+
+bool any_within_scalar(const double *pos_x, const double *pos_y, size_t len,
+                       double x, double y, double distance_sq);
@@ -0,0 +1,171 @@
+#include "grid.h"
+
+/**
+ * @brief Creates an empty grid covering the given limits, enlarged by a margin
+ *
+ * The side of the cells is the smallest value not lower than \p cell_size that
+ * keeps the number of cells within \c GRID_MAX_CELLS .
+ *
+ * @param[in] limits rectangle to be covered by the grid
+ * @param[in] margin distance by which the rectangle is enlarged on each side
+ * @param[in] cell_size minimum side of a cell, must be positive
+ * @return grid_t
+ */
+grid_t create_grid(limits_t *limits, double margin, double cell_size) {
+  grid_t grid;
+  double width = limits->xmax - limits->xmin + 2 * margin;
+  double length = limits->ymax - limits->ymin + 2 * margin;
+  /* Enlarge the cells if they would be too many */
+  cell_size = MAX(cell_size, sqrt(width * length / GRID_MAX_CELLS));
+
+  grid.x0 = limits->xmin - margin;
+  grid.y0 = limits->ymin - margin;
+  grid.cell_size = cell_size;
+  grid.cols = MAX((long)ceil(width / cell_size), 1);
+  grid.rows = MAX((long)ceil(length / cell_size), 1);
+  grid.cell_start = calloc(grid.cols * grid.rows + 1, sizeof(size_t));
+  grid.pos_x = grid.pos_y = grid.raw_x = grid.raw_y = NULL;
+  grid.item_cell = NULL;
+  grid.item_index = NULL;
+  grid.len = grid.capacity = 0;
+  return grid;
+}
+
+/**
+ * @brief Frees the dynamically allocated buffers of a grid
+ *
+ * @param[in,out] grid
+ */
+void free_grid(grid_t *grid) {
+  free(grid->cell_start);
+  free(grid->pos_x);
+  free(grid->pos_y);
+  free(grid->raw_x);
+  free(grid->raw_y);
+  free(grid->item_cell);
+  free(grid->item_index);
+}
+
+/**
+ * @brief Calculates the column of the cell containing the given abscissa
+ *
+ * Points outside the grid are assigned to the nearest column.
+ *
+ * @param[in] grid
+ * @param[in] x
+ * @return long column index in <tt>[0, cols)</tt>
+ */
+long grid_cell_col(grid_t *grid, double x) {
+  long col = (long)floor((x - grid->x0) / grid->cell_size);
+  return col < 0 ? 0 : (col >= grid->cols ? grid->cols - 1 : col);
+}
+
+/**
+ * @brief Calculates the row of the cell containing the given ordinate
+ *
+ * Points outside the grid are assigned to the nearest row.
+ *
+ * @param[in] grid
+ * @param[in] y
+ * @return long row index in <tt>[0, rows)</tt>
+ */
+long grid_cell_row(grid_t *grid, double y) {
+  long row = (long)floor((y - grid->y0) / grid->cell_size);
+  return row < 0 ? 0 : (row >= grid->rows ? grid->rows - 1 : row);
+}
+
+/**
+ * @brief Removes all the items from the grid
+ *
+ * @param[in,out] grid
+ */
+void grid_reset(grid_t *grid) {
+  memset(grid->cell_start, 0, (grid->cols * grid->rows + 1) * sizeof(size_t));
+  grid->len = 0;
+}
+
+/**
+ * @brief Inserts a position into the grid
+ *
+ * The position is not visible to queries until \c grid_sort() is called.
+ *
+ * @param[in,out] grid
+ * @param[in] x abscissa of the position
+ * @param[in] y ordinate of the position
+ */
+void grid_insert(grid_t *grid, double x, double y) {
+  if (grid->len >= grid->capacity) {
+    grid->capacity += DYN_ARRAY_CHUNK;
+    grid->pos_x = realloc(grid->pos_x, grid->capacity * sizeof(double));
+    grid->pos_y = realloc(grid->pos_y, grid->capacity * sizeof(double));
+    grid->raw_x = realloc(grid->raw_x, grid->capacity * sizeof(double));
+    grid->raw_y = realloc(grid->raw_y, grid->capacity * sizeof(double));
+    grid->item_cell = realloc(grid->item_cell, grid->capacity * sizeof(long));
+    grid->item_index =
+        realloc(grid->item_index, grid->capacity * sizeof(size_t));
+  }
+  grid->raw_x[grid->len] = x;
+  grid->raw_y[grid->len] = y;
+  grid->item_cell[grid->len] =
+      grid_cell_row(grid, y) * grid->cols + grid_cell_col(grid, x);
+  /* Count the items of each cell, shifted by one for the prefix sum */
+  grid->cell_start[grid->item_cell[grid->len] + 1]++;
+  grid->len++;
+}
+
+/**
+ * @brief Sorts the inserted positions by cell, making them visible to queries
+ *
+ * This is the final pass of a counting sort, whose counts have been collected
+ * by \c grid_insert() .
+ *
+ * @param[in,out] grid
+ */
+void grid_sort(grid_t *grid) {
+  const size_t num_cells = grid->cols * grid->rows;
+
+  /* Prefix sum of the counts gives the first index of each cell */
+  for (size_t c = 0; c < num_cells; c++) {
+    grid->cell_start[c + 1] += grid->cell_start[c];
+  }
+
+  /* Scatter the positions, using cell_start as insertion cursors */
+  for (size_t n = 0; n < grid->len; n++) {
+    size_t k = grid->cell_start[grid->item_cell[n]]++;
+    grid->pos_x[k] = grid->raw_x[n];
+    grid->pos_y[k] = grid->raw_y[n];
+    grid->item_index[k] = n;
+  }
+  /* The cursors now point to the end of each cell: shift them back */
+  memmove(grid->cell_start + 1, grid->cell_start, num_cells * sizeof(size_t));
+  grid->cell_start[0] = 0;
+}
+
+/**
+ * @brief Checks whether any binned item lies within a distance from a point
+ *
+ * Only the cell of the point and the 8 surrounding ones are searched, which is
+ * exhaustive as long as \p distance does not exceed the side of the cells.
+ * The items of each row of cells are checked with the \c any_within kernel.
+ *
+ * @param[in] grid
+ * @param[in] x abscissa of the point
+ * @param[in] y ordinate of the point
+ * @param[in] distance inclusive distance
+ * @return true if at least one item is found
+ */
+bool grid_any_within(grid_t *grid, double x, double y, double distance) {
+  long col = grid_cell_col(grid, x);
+  long row = grid_cell_row(grid, y);
+  for (long r = MAX(row - 1, 0); r <= MIN(row + 1, grid->rows - 1); r++) {
+    /* Cells in the same row are contiguous, scan them in a single range */
+    size_t begin = grid->cell_start[r * grid->cols + MAX(col - 1, 0)];
+    size_t end =
+        grid->cell_start[r * grid->cols + MIN(col + 1, grid->cols - 1) + 1];
+    if (any_within(grid->pos_x + begin, grid->pos_y + begin, end - begin, x, y,
+                   distance * distance)) {
+      return true;
+    }
+  }
+  return false;
+}
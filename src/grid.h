@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "exposure-kernel.h"
+#include "utils.h"
+#include "world.h"
+
+/* Upper bound on the number of cells of a grid, to keep memory bounded when
+ * the spreading distance is very small compared to the country */
+#define GRID_MAX_CELLS (1 << 20)
+
+/**
+ * @brief Uniform grid of square cells covering a rectangle (cell list)
+ *
+ * A set of positions is binned into cells of side at least \c cell_size , so
+ * that all the positions within \c cell_size from a given point can be found
+ * in the cell of the point and in the 8 surrounding ones.
+ *
+ * The grid is filled by calling \c grid_reset() , then \c grid_insert() for
+ * each position and finally \c grid_sort() . After sorting, the binned
+ * positions are stored contiguously by cell: the items of cell \c c are at
+ * indices <tt>[cell_start[c], cell_start[c+1])</tt> , and \c item_index maps
+ * them back to the order of insertion.
+ */
+typedef struct grid {
+  double x0, y0;         /**< (x,y) position of the lower-left corner */
+  double cell_size;      /**< Side of a cell */
+  long cols, rows;       /**< Number of cells on each axis */
+  size_t *cell_start;    /**< Index of the first item of each cell, plus one
+                            final entry holding the number of items */
+  double *pos_x, *pos_y; /**< Binned positions, sorted by cell */
+  double *raw_x, *raw_y; /**< Inserted positions, before sorting */
+  long *item_cell;       /**< Cell of each inserted position */
+  size_t *item_index;    /**< Insertion index of each binned position */
+  size_t len;            /**< Number of binned items */
+  size_t capacity;       /**< Capacity of the item arrays */
+} grid_t;
+
+grid_t create_grid(limits_t *limits, double margin, double cell_size);
+
+void free_grid(grid_t *grid);
+
+void grid_reset(grid_t *grid);
+
+void grid_insert(grid_t *grid, double x, double y);
+
+void grid_sort(grid_t *grid);
+
+long grid_cell_col(grid_t *grid, double x);
+
+long grid_cell_row(grid_t *grid, double y);
+
+bool grid_any_within(grid_t *grid, double x, double y, double distance);
@@ -39,7 +39,6 @@ void print_individual(individual_t *ind) {
  *
  * The individual will have the specified id, <tt>pos, displ = {0,0}</tt>
  * <tt>status = NOT_EXPOSED</tt>, <tt>t_status = 0</tt>.
- * The list pointer is uninitialized.
  *
  * @param[in] id
  * @return individual_t
@@ -50,16 +49,6 @@ individual_t *create_individual(unsigned long id) {
   ind->pos[0] = ind->pos[1] = ind->displ[0] = ind->displ[1] = 0.;
   ind->status = NOT_EXPOSED;
   ind->t_status = 0;
+  ind->t_motion = 0;
   return ind;
 }
-
-/**
- * @brief Create an empty list of individuals
- *
- * @return individual_list_t
- */
-individual_list_t create_individual_list() {
-  individual_list_t head = SLIST_HEAD_INITIALIZER(head);
-  SLIST_INIT(&head);
-  return head;
-}
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -18,8 +19,6 @@ typedef enum individual_status {
 
 char *individual_status_string(int status);
 
-typedef SLIST_HEAD(individual_list, individual) individual_list_t;
-
 /**
  * @brief Represents an individual
  *
@@ -32,9 +31,50 @@ typedef struct individual {
   individual_status_t status; /**< current status of the individual */
   unsigned long t_status;     /**< Time passed since the individual entered the
                                 current status */
-  SLIST_ENTRY(individual) individuals;
+  unsigned long t_motion;     /**< Time passed since pos and displ, if immune */
 } individual_t;
 
+/**
+ * @brief Position of an infected individual of a neighbor country (ghost)
+ *
+ * Infected individuals close to a border are shared with the neighbor country
+ * in this compact form, since only their position and displacement are needed
+ * to update the exposure on the other side of the border.
+ */
+typedef struct ghost {
+  double pos[2];   /**< (x,y) position */
+  double displ[2]; /**< (dx, dy) displacement, for the swept exposure */
+} ghost_t;
+
+/* Number of bits of migrant_t.status_timer holding t_status, the remaining
+ * ones hold the status */
+#define MIGRANT_TIMER_BITS 30
+#define MIGRANT_TIMER_MAX ((1UL << MIGRANT_TIMER_BITS) - 1)
+
+#define MIGRANT_PACK_STATUS(status, t_status) \
+  (((uint32_t)(status) << MIGRANT_TIMER_BITS) | (uint32_t)(t_status))
+#define MIGRANT_STATUS(m) ((m)->status_timer >> MIGRANT_TIMER_BITS)
+#define MIGRANT_T_STATUS(m) ((m)->status_timer & MIGRANT_TIMER_MAX)
+
+/**
+ * @brief Record of an individual crossing the border of a country
+ *
+ * The status and its timer are packed in 32 bits. The motion is either kept in
+ * full precision, or in the compact format, in single precision with the
+ * position relative to the origin of the destination country, which keeps the
+ * error around a millimeter for countries of 10 km.
+ */
+typedef struct migrant {
+  unsigned long id;      /**< Unique id for this individual in the world */
+  uint32_t country;      /**< Index of the destination country */
+  uint32_t status_timer; /**< Status and t_status, see MIGRANT_PACK_STATUS */
+  union {
+    double full[4];   /**< (x, y) position, (dx, dy) displacement */
+    float compact[4]; /**< (x, y) position relative to the origin of the
+                         destination country, (dx, dy) displacement */
+  } motion;
+} migrant_t;
+
 /**
  * @brief Represents the summary of the number of individuals for each status
  *
@@ -48,29 +88,3 @@ typedef struct summary {
 void print_individual(individual_t *ind);
 
 individual_t *create_individual(unsigned long id);
-
-individual_list_t create_individual_list();
-
-#define INDIVIDUAL_DISTANCE(ind1, ind2)      \
-  sqrt(pow(ind1->pos[0] - ind2->pos[0], 2) + \
-       pow(ind1->pos[1] - ind2->pos[1], 2))
-
-#define INDIVIDUAL_INSERT(head, ind) SLIST_INSERT_HEAD(head, ind, individuals)
-
-#define INDIVIDUAL_EMPTY(head) SLIST_EMPTY(head)
-
-#define INDIVIDUAL_FIRST(head) SLIST_FIRST(head)
-
-#define INDIVIDUAL_NEXT(ind) SLIST_NEXT(ind, individuals)
-
-#define INDIVIDUAL_FOREACH(var, head) SLIST_FOREACH(var, head, individuals)
-
-#define INDIVIDUAL_REMOVE_HEAD(head) SLIST_REMOVE_HEAD(head, individuals)
-
-#define INDIVIDUAL_REMOVE_AFTER(ind) SLIST_REMOVE_AFTER(ind, individuals)
-
-#define INDIVIDUAL_COUNT(head, count) \
-  SLIST_COUNT(head, individuals, individual, count)
-
-#define INDIVIDUAL_REMOVE(head, ind) \
-  SLIST_REMOVE(head, ind, individual, individuals)
@@ -0,0 +1,154 @@
+#include "kdtree.h"
+
+/**
+ * @brief Swaps two positions
+ *
+ * @param[in,out] pos_x abscissae of the positions
+ * @param[in,out] pos_y ordinates of the positions
+ * @param[in] i index of the first position
+ * @param[in] j index of the second position
+ */
+static void swap_positions(double *pos_x, double *pos_y, size_t i, size_t j) {
+  double tmp = pos_x[i];
+  pos_x[i] = pos_x[j];
+  pos_x[j] = tmp;
+  tmp = pos_y[i];
+  pos_y[i] = pos_y[j];
+  pos_y[j] = tmp;
+}
+
+/**
+ * @brief Moves the k-th smallest position of a range along an axis to index
+ * \p k , with the lower ones before and the greater ones after it
+ *
+ * This is a quickselect with a three-way partition, so that ranges with many
+ * equal coordinates are not degenerate.
+ *
+ * @param[in,out] pos_x abscissae of the positions
+ * @param[in,out] pos_y ordinates of the positions
+ * @param[in] lo first index of the range
+ * @param[in] hi index past the end of the range
+ * @param[in] k index to be placed, in <tt>[lo, hi)</tt>
+ * @param[in] axis 0 for the abscissae, 1 for the ordinates
+ */
+static void select_nth(double *pos_x, double *pos_y, size_t lo, size_t hi,
+                       size_t k, int axis) {
+  const double *key = axis ? pos_y : pos_x;
+  while (hi - lo > 1) {
+    const double pivot = key[lo + (hi - lo) / 2];
+    /* Split into [lo, lt) lower, [lt, gt) equal and [gt, hi) greater */
+    size_t lt = lo, i = lo, gt = hi;
+    while (i < gt) {
+      if (key[i] < pivot) {
+        swap_positions(pos_x, pos_y, lt++, i++);
+      } else if (key[i] > pivot) {
+        swap_positions(pos_x, pos_y, i, --gt);
+      } else {
+        i++;
+      }
+    }
+    if (k < lt) {
+      hi = lt;
+    } else if (k >= gt) {
+      lo = gt;
+    } else {
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Arranges a range of positions as a subtree
+ *
+ * @param[in,out] pos_x abscissae of the positions
+ * @param[in,out] pos_y ordinates of the positions
+ * @param[in] lo first index of the range
+ * @param[in] hi index past the end of the range
+ * @param[in] axis axis of the root of the subtree
+ */
+static void build_range(double *pos_x, double *pos_y, size_t lo, size_t hi,
+                        int axis) {
+  /* Recur on the lower half, iterate on the upper one */
+  while (hi - lo > KDTREE_LEAF_SIZE) {
+    size_t m = lo + (hi - lo) / 2;
+    select_nth(pos_x, pos_y, lo, hi, m, axis);
+    build_range(pos_x, pos_y, lo, m, !axis);
+    lo = m + 1;
+    axis = !axis;
+  }
+}
+
+/**
+ * @brief Arranges some positions as a 2-d tree, in place
+ *
+ * @param[in,out] pos_x abscissae of the positions
+ * @param[in,out] pos_y ordinates of the positions
+ * @param[in] len number of positions
+ */
+void kdtree_build(double *pos_x, double *pos_y, size_t len) {
+  build_range(pos_x, pos_y, 0, len, 0);
+}
+
+/**
+ * @brief Checks whether any position of a subtree lies within a distance from
+ * a point
+ *
+ * The side of the splitting line where the point lies is searched first, and
+ * the other one only if the line is within the distance. A pruned side cannot
+ * hold any match, as the difference and the square of the coordinates are
+ * monotonic also when rounded.
+ *
+ * @param[in] pos_x abscissae of the positions
+ * @param[in] pos_y ordinates of the positions
+ * @param[in] lo first index of the subtree
+ * @param[in] hi index past the end of the subtree
+ * @param[in] axis axis of the root of the subtree
+ * @param[in] x abscissa of the point
+ * @param[in] y ordinate of the point
+ * @param[in] distance_sq square of the inclusive distance
+ * @return true if at least one position is found
+ */
+static bool search_range(const double *pos_x, const double *pos_y, size_t lo,
+                         size_t hi, int axis, double x, double y,
+                         double distance_sq) {
+  while (hi - lo > KDTREE_LEAF_SIZE) {
+    size_t m = lo + (hi - lo) / 2;
+    if (any_within(pos_x + m, pos_y + m, 1, x, y, distance_sq)) {
+      return true;
+    }
+    double delta = axis ? y - pos_y[m] : x - pos_x[m];
+    size_t near_lo = delta <= 0. ? lo : m + 1;
+    size_t near_hi = delta <= 0. ? m : hi;
+    if (delta * delta <= distance_sq) {
+      if (search_range(pos_x, pos_y, near_lo, near_hi, !axis, x, y,
+                       distance_sq)) {
+        return true;
+      }
+      /* Continue on the far side */
+      lo = delta <= 0. ? m + 1 : lo;
+      hi = delta <= 0. ? hi : m;
+    } else {
+      lo = near_lo;
+      hi = near_hi;
+    }
+    axis = !axis;
+  }
+  return any_within(pos_x + lo, pos_y + lo, hi - lo, x, y, distance_sq);
+}
+
+/**
+ * @brief Checks whether any position of a 2-d tree lies within a distance from
+ * a point
+ *
+ * @param[in] pos_x abscissae of the positions, arranged by \c kdtree_build()
+ * @param[in] pos_y ordinates of the positions, arranged by \c kdtree_build()
+ * @param[in] len number of positions
+ * @param[in] x abscissa of the point
+ * @param[in] y ordinate of the point
+ * @param[in] distance inclusive distance
+ * @return true if at least one position is found
+ */
+bool kdtree_any_within(const double *pos_x, const double *pos_y, size_t len,
+                       double x, double y, double distance) {
+  return search_range(pos_x, pos_y, 0, len, 0, x, y, distance * distance);
+}
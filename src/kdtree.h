@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "exposure-kernel.h"
+
+/* Largest range of positions that is scanned without being split */
+#define KDTREE_LEAF_SIZE 8
+
+/*
+ * A 2-d tree is stored implicitly in the arrays of the positions: the median
+ * of a range, along the axis of its depth, splits it into the positions not
+ * greater and not lower than it, each one being a subtree. Ranges of at most
+ * KDTREE_LEAF_SIZE positions are leaves, scanned with the \c any_within
+ * kernel.
+ */
+
+void kdtree_build(double *pos_x, double *pos_y, size_t len);
+
+bool kdtree_any_within(const double *pos_x, const double *pos_y, size_t len,
+                       double x, double y, double distance);
@@ -0,0 +1,75 @@
+#include "migration.h"
+
+/**
+ * @brief Creates an empty migration buffer for each thread
+ *
+ * @param[in] num_threads number of threads
+ * @return thread_migration_t* dynamically allocated array of \p num_threads
+ * buffers
+ */
+thread_migration_t *create_thread_migrations(int num_threads) {
+  /* All-zero is a valid empty buffer */
+  return calloc(num_threads, sizeof(thread_migration_t));
+}
+
+/**
+ * @brief Frees the per-thread migration buffers
+ *
+ * @param[in,out] tm array of buffers
+ * @param[in] num_threads number of threads
+ */
+void free_thread_migrations(thread_migration_t *tm, int num_threads) {
+  for (int t = 0; t < num_threads; t++) {
+    for (int i = 0; i < NEIGHBOR_COUNT; i++) {
+      free(tm[t].migrated_out[i]);
+    }
+    free(tm[t].removed);
+  }
+  free(tm);
+}
+
+/**
+ * @brief Merges the buffers filled by each thread into the outbound buffers of
+ * the country, and removes the outbound individuals from the population
+ *
+ * The per-thread buffers are emptied, but their memory is kept for reuse.
+ *
+ * @param[in,out] tm array of per-thread buffers
+ * @param[in] num_threads number of threads
+ * @param[in,out] population population the individuals were collected from
+ * @param[in,out] migrated_out buffer indexed by cardinal point where to append
+ * outbound individuals
+ * @param[in,out] migrated_out_len currently used size of the buffer (in number
+ * of individuals) for each position
+ * @param[in,out] migrated_out_capacity current capacity of each position of the
+ * buffer
+ */
+void merge_thread_migrations(thread_migration_t *tm, int num_threads,
+                             population_t *population,
+                             migrant_t *migrated_out[],
+                             size_t migrated_out_len[],
+                             size_t migrated_out_capacity[]) {
+  /* Concatenate the outbound individuals */
+  for (int t = 0; t < num_threads; t++) {
+    for (int i = 0; i < NEIGHBOR_COUNT; i++) {
+      if (tm[t].migrated_out_len[i] == 0) {
+        continue;
+      }
+      size_t len = migrated_out_len[i] + tm[t].migrated_out_len[i];
+      DYN_ARRAY_EXTEND(migrated_out[i], len, migrated_out_capacity[i],
+                       migrant_t);
+      memcpy(migrated_out[i] + migrated_out_len[i], tm[t].migrated_out[i],
+             tm[t].migrated_out_len[i] * sizeof(migrant_t));
+      migrated_out_len[i] = len;
+      tm[t].migrated_out_len[i] = 0;
+    }
+  }
+  /* Remove them from the population in descending order of index, so that each
+   * removal only moves individuals that are not going to be removed */
+  for (int t = num_threads - 1; t >= 0; t--) {
+    for (size_t k = tm[t].removed_len; k-- > 0;) {
+      population_remove(population, tm[t].removed[k]);
+    }
+    tm[t].removed_len = 0;
+  }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "individual.h"
+#include "population.h"
+#include "utils.h"
+#include "world.h"
+
+/**
+ * @brief Individuals that left the country during a step, collected by a
+ * single thread
+ *
+ * Each thread processes a contiguous, ascending range of indices of the
+ * population, so \c removed is sorted in ascending order.
+ */
+typedef struct thread_migration {
+  migrant_t *migrated_out[NEIGHBOR_COUNT]; /**< Outbound individuals,
+                                              indexed by cardinal point */
+  size_t migrated_out_len[NEIGHBOR_COUNT];
+  size_t migrated_out_capacity[NEIGHBOR_COUNT];
+  size_t *removed; /**< Indices in the population of the outbound individuals */
+  size_t removed_len;
+  size_t removed_capacity;
+} thread_migration_t;
+
+thread_migration_t *create_thread_migrations(int num_threads);
+
+void free_thread_migrations(thread_migration_t *tm, int num_threads);
+
+void merge_thread_migrations(thread_migration_t *tm, int num_threads,
+                             population_t *population,
+                             migrant_t *migrated_out[],
+                             size_t migrated_out_len[],
+                             size_t migrated_out_capacity[]);
@@ -11,26 +11,57 @@ MPI_Datatype create_type_mpi_global_config() {
   MPI_Datatype mpi_global_config;
   global_config_t cfg;
   /**
-   * We use four blocks:
+   * We use nineteen blocks:
    * - MPI_UNSIGNED_LONG (6 elements)
    * - MPI_DOUBLE (2 elements)
-   * - MPI_UNSIGNED_LONG (9 elements)
-   * - MPI_INT (2 elements)
+   * - MPI_UNSIGNED_LONG (5 elements)
+   * - MPI_UNSIGNED (1 element)
+   * - MPI_INT (1 element)
+   * - MPI_C_BOOL (1 element)
+   * - MPI_INT (1 element)
+   * - MPI_UNSIGNED_LONG (1 element)
+   * - MPI_C_BOOL (1 element)
+   * - MPI_UNSIGNED_LONG (1 element)
+   * - MPI_C_BOOL (1 element)
+   * - MPI_UNSIGNED_LONG (1 element)
+   * - MPI_DOUBLE (5 elements)
+   * - MPI_UNSIGNED_LONG (1 element)
+   * - MPI_CHAR (PATH_MAX elements)
+   * - MPI_DOUBLE (1 element)
+   * - MPI_INT (1 element)
+   * - MPI_C_BOOL (1 element)
+   * - MPI_UNSIGNED_LONG (1 element)
    */
-  int num_blocks = 4;
-  const int block_lengths[] = {6, 2, 9, 2};
+  int num_blocks = 19;
+  const int block_lengths[] = {6, 2, 5, 1, 1, 1, 1, 1, 1, 1,
+                               1, 1, 5, 1, PATH_MAX, 1, 1, 1, 1};
   const MPI_Aint displacements[] = {
-      0,
       (size_t) & (cfg.num_individuals) - (size_t) & (cfg),
       (size_t) & (cfg.velocity) - (size_t) & (cfg),
       (size_t) & (cfg.t_infection) - (size_t) & (cfg),
+      (size_t) & (cfg.rand_seed) - (size_t) & (cfg),
       (size_t) & (cfg.log_level) - (size_t) & (cfg),
+      (size_t) & (cfg.write_trace) - (size_t) & (cfg),
+      (size_t) & (cfg.num_threads) - (size_t) & (cfg),
+      (size_t) & (cfg.balance_every) - (size_t) & (cfg),
+      (size_t) & (cfg.compact_migration) - (size_t) & (cfg),
+      (size_t) & (cfg.check_every) - (size_t) & (cfg),
+      (size_t) & (cfg.shared_trace) - (size_t) & (cfg),
+      (size_t) & (cfg.trace_every) - (size_t) & (cfg),
+      (size_t) & (cfg.trace_sample_rate) - (size_t) & (cfg),
+      (size_t) & (cfg.checkpoint_every) - (size_t) & (cfg),
+      (size_t) & (cfg.restart_from) - (size_t) & (cfg),
+      (size_t) & (cfg.verlet_skin) - (size_t) & (cfg),
+      (size_t) & (cfg.exposure_engine) - (size_t) & (cfg),
+      (size_t) & (cfg.swept_exposure) - (size_t) & (cfg),
+      (size_t) & (cfg.locality_every) - (size_t) & (cfg),
   };
   MPI_Datatype block_types[] = {
-      MPI_UNSIGNED_LONG,
-      MPI_DOUBLE,
-      MPI_UNSIGNED_LONG,
-      MPI_INT,
+      MPI_UNSIGNED_LONG, MPI_DOUBLE, MPI_UNSIGNED_LONG, MPI_UNSIGNED,
+      MPI_INT,           MPI_C_BOOL, MPI_INT,    MPI_UNSIGNED_LONG,
+      MPI_C_BOOL,        MPI_UNSIGNED_LONG, MPI_C_BOOL, MPI_UNSIGNED_LONG,
+      MPI_DOUBLE,        MPI_UNSIGNED_LONG, MPI_CHAR,   MPI_DOUBLE,
+      MPI_INT,           MPI_C_BOOL,        MPI_UNSIGNED_LONG,
   };
   MPI_Type_create_struct(num_blocks, block_lengths, displacements, block_types,
                          &mpi_global_config);
@@ -49,24 +80,25 @@ MPI_Datatype create_type_mpi_individual() {
   MPI_Datatype mpi_individual;
   individual_t ind;
   /**
-   * We use five blocks:
+   * We use four blocks:
    * - MPI_UNSIGNED_LONG (1 element)
    * - MPI_DOUBLE (4 elements)
    * - MPI_INT (1 element)
-   * - MPI_UNSIGNED_LONG (1 element)
-   * - MPI_AINT (1 element)
+   * - MPI_UNSIGNED_LONG (2 elements)
    */
-  int num_blocks = 5;
-  const int block_lengths[] = {1, 4, 1, 1, 1};
+  int num_blocks = 4;
+  const int block_lengths[] = {1, 4, 1, 2};
   const MPI_Aint displacements[] = {
       0,
       (size_t) & (ind.pos) - (size_t) & (ind),
       (size_t) & (ind.status) - (size_t) & (ind),
       (size_t) & (ind.t_status) - (size_t) & (ind),
-      (size_t) & (ind.individuals) - (size_t) & (ind),
   };
   MPI_Datatype block_types[] = {
-      MPI_UNSIGNED_LONG, MPI_DOUBLE, MPI_INT, MPI_UNSIGNED_LONG, MPI_AINT,
+      MPI_UNSIGNED_LONG,
+      MPI_DOUBLE,
+      MPI_INT,
+      MPI_UNSIGNED_LONG,
   };
   MPI_Type_create_struct(num_blocks, block_lengths, displacements, block_types,
                          &mpi_individual);
@@ -76,29 +108,71 @@ MPI_Datatype create_type_mpi_individual() {
 }
 
 /**
- * @brief Create the MPI version of the summary_t datatype.
+ * @brief Create the MPI version of the ghost_t datatype.
  *
  * The type is both created and committed, but needs to be freed after use.
  *
  * @return MPI_Datatype
  */
-MPI_Datatype create_type_mpi_summary() {
-  MPI_Datatype mpi_summary;
+MPI_Datatype create_type_mpi_ghost() {
+  MPI_Datatype mpi_ghost;
   /**
    * We use one block:
-   * - MPI_UNSIGNED_LONG (3 elements)
+   * - MPI_DOUBLE (4 elements)
    */
   int num_blocks = 1;
-  const int block_lengths[] = {3};
+  const int block_lengths[] = {4};
+  const MPI_Aint displacements[] = {
+      0,
+  };
+  MPI_Datatype block_types[] = {
+      MPI_DOUBLE,
+  };
+  MPI_Type_create_struct(num_blocks, block_lengths, displacements, block_types,
+                         &mpi_ghost);
+  MPI_Type_commit(&mpi_ghost);
+
+  return mpi_ghost;
+}
+
+/**
+ * @brief Create the MPI version of the migrant_t datatype.
+ *
+ * Only the variant of the motion given by \p compact is transferred, and the
+ * extent is the one of migrant_t, so arrays of records can be sent.
+ *
+ * The type is both created and committed, but needs to be freed after use.
+ *
+ * @param[in] compact whether the records use the compact format
+ * @return MPI_Datatype
+ */
+MPI_Datatype create_type_mpi_migrant(bool compact) {
+  MPI_Datatype mpi_migrant, mpi_migrant_struct;
+  migrant_t m;
+  /**
+   * We use three blocks:
+   * - MPI_UNSIGNED_LONG (1 element)
+   * - MPI_UINT32_T (2 elements)
+   * - MPI_DOUBLE or MPI_FLOAT (4 elements)
+   */
+  int num_blocks = 3;
+  const int block_lengths[] = {1, 2, 4};
   const MPI_Aint displacements[] = {
       0,
+      (size_t) & (m.country) - (size_t) & (m),
+      (size_t) & (m.motion) - (size_t) & (m),
   };
   MPI_Datatype block_types[] = {
       MPI_UNSIGNED_LONG,
+      MPI_UINT32_T,
+      compact ? MPI_FLOAT : MPI_DOUBLE,
   };
   MPI_Type_create_struct(num_blocks, block_lengths, displacements, block_types,
-                         &mpi_summary);
-  MPI_Type_commit(&mpi_summary);
+                         &mpi_migrant_struct);
+  MPI_Type_create_resized(mpi_migrant_struct, 0, sizeof(migrant_t),
+                          &mpi_migrant);
+  MPI_Type_commit(&mpi_migrant);
+  MPI_Type_free(&mpi_migrant_struct);
 
-  return mpi_summary;
-}
\ No newline at end of file
+  return mpi_migrant;
+}
@@ -7,4 +7,6 @@ MPI_Datatype create_type_mpi_global_config();
 
 MPI_Datatype create_type_mpi_individual();
 
-MPI_Datatype create_type_mpi_summary();
\ No newline at end of file
+MPI_Datatype create_type_mpi_ghost();
+
+MPI_Datatype create_type_mpi_migrant(bool compact);
\ No newline at end of file
@@ -1,65 +1,104 @@
 #include <argp.h>
 #include <argz.h>
 #include <mpi.h>
+#include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
+#include "checkpoint.h"
 #include "config.h"
+#include "country.h"
 #include "csv.h"
+#include "domain.h"
+#include "exposure-engine.h"
+#include "migration.h"
 #include "mpi-datatypes.h"
+#include "population.h"
+#include "rng.h"
+#include "trace.h"
 #include "utils.h"
 #include "world.h"
+#include "writer.h"
 
 /* MPI communication tags */
-#define MIGRATED_TAG 1
+#define HALO_TAG 2
+#define HALO_COUNT_TAG 4
 
 /* Function prototypes */
-void initialize_individuals(global_config_t *cfg, int num_countries,
-                            individual_list_t *susceptible_individuals,
-                            individual_list_t *infected_individuals);
+void initialize_individuals(global_config_t *cfg, country_t *country,
+                            unsigned long num_individuals,
+                            unsigned long num_infected,
+                            unsigned long initial_id);
 
-void free_individuals(individual_list_t *individuals);
+void post_count_receives(domain_t *domain, MPI_Request requests[],
+                         size_t counts[], int tag);
 
-void update_exposure(double spreading_distance,
-                     individual_list_t *susceptible_individuals,
-                     individual_list_t *infected_individuals);
+void update_halo_out(double reach, domain_t *domain, country_t *country,
+                     ghost_t *halo_out[], size_t halo_out_len[],
+                     size_t halo_out_capacity[]);
 
-void update_status(global_config_t *cfg,
-                   individual_list_t *susceptible_individuals,
-                   individual_list_t *infected_individuals,
-                   individual_list_t *immune_individuals);
+void send_halo_out(domain_t *domain, MPI_Request requests[],
+                   ghost_t *halo_out[], size_t halo_out_len[],
+                   MPI_Datatype mpi_ghost);
 
-void update_position(global_config_t *cfg, individual_list_t *individuals,
-                     individual_list_t *gc_individuals,
-                     individual_t *migrated_out[], size_t migrated_out_len[],
-                     size_t migrated_out_capacity[], limits_t *limits,
-                     int neighbors[]);
+void receive_halo_in(global_config_t *cfg, domain_t *domain,
+                     MPI_Request requests[], ghost_t *halo_in[],
+                     size_t halo_in_len[], size_t halo_in_capacity[],
+                     MPI_Datatype mpi_ghost);
 
-void send_migrated_out(MPI_Request requests[], individual_t *migrated_out[],
-                       size_t migrated_out_len[], int neighbors[],
-                       MPI_Datatype mpi_individual);
+void integrate_halo_in(global_config_t *cfg, domain_t *domain,
+                       ghost_t halo_in[], size_t halo_in_len);
 
-void receive_migrated_in(individual_t *migrated_in[], size_t migrated_in_len[],
-                         size_t migrated_in_capacity[], int neighbors[],
-                         MPI_Datatype mpi_individual);
+void update_verlet_flags(double reach, country_t *country);
 
-void integrate_migrated_in(individual_t *migrated_in[],
-                           size_t migrated_in_len[], int neighbors[],
-                           individual_list_t *susceptible_individuals,
-                           individual_list_t *infected_individuals,
-                           individual_list_t *immune_individuals,
-                           individual_list_t *gc_individuals);
+void update_exposure(global_config_t *cfg, domain_t *domain,
+                     country_t *country, bool border);
 
-void wait_all_requests(MPI_Request requests[], int neighbors[]);
+unsigned char next_status(global_config_t *cfg, unsigned char status,
+                          unsigned long *t_status);
 
-void free_migrated(individual_t *migrated[], int neighbors[]);
+void update_status(global_config_t *cfg, population_t *population);
 
-limits_t calculate_country_limits(global_config_t *cfg, int num_countries,
-                                  int rank);
+void update_migrated_status(global_config_t *cfg, country_t *country);
 
-void calculate_neighbors(int neighbors[], global_config_t *cfg,
-                         int num_countries, int rank);
+void update_position(global_config_t *cfg, country_t *country,
+                     thread_migration_t *thread_migrations);
+
+void pack_migrated_out(domain_t *domain, migrant_t **migrated_out,
+                       size_t *migrated_out_capacity, int send_counts[],
+                       int send_displs[]);
+
+void move_migrated_local(global_config_t *cfg, domain_t *domain);
+
+void send_migrated_out(domain_t *domain, MPI_Request *request,
+                       migrant_t *migrated_out, int send_counts[],
+                       int send_displs[], migrant_t **migrated_in,
+                       size_t *migrated_in_len, size_t *migrated_in_capacity,
+                       int recv_counts[], int recv_displs[],
+                       MPI_Datatype mpi_migrant);
+
+void receive_migrated_in(global_config_t *cfg, domain_t *domain,
+                         MPI_Request *request, migrant_t migrated_in[],
+                         size_t migrated_in_len);
+
+void integrate_migrated_in(global_config_t *cfg, domain_t *domain,
+                           migrant_t migrated_in[], size_t migrated_in_len);
+
+void complete_summary(MPI_Request *request, bool blocking,
+                      writer_t *summary_csv, summary_t summaries[],
+                      unsigned long summary_days[], size_t num_summaries,
+                      size_t len);
+
+void update_locality(country_t *country, bool check, locality_stats_t *stats);
+
+void log_memory_usage(domain_t *domain);
+
+void log_locality_stats(domain_t *domain, locality_stats_t *stats);
+
+void wait_all_requests(MPI_Request requests[], int count);
+
+void free_halo(ghost_t *halo[], int world_size);
 
 int main(int argc, char **argv) {
   /* -------------------------------------------------------------------------*/
@@ -68,8 +107,9 @@ int main(int argc, char **argv) {
   /* Set default log level */
   log_set_level(LOG_DEFAULT);
 
-  /* Initialize MPI */
-  MPI_Init(&argc, &argv);
+  /* Initialize MPI: only the main thread performs MPI calls */
+  int thread_support;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
 
   /* Get information about MPI environment */
   int world_size, rank;
@@ -80,7 +120,7 @@ int main(int argc, char **argv) {
   /* Create custom MPI datatypes */
   MPI_Datatype mpi_global_config = create_type_mpi_global_config();
   MPI_Datatype mpi_individual = create_type_mpi_individual();
-  MPI_Datatype mpi_summary = create_type_mpi_summary();
+  MPI_Datatype mpi_ghost = create_type_mpi_ghost();
 
   /* Read and parse command-line configuration */
   global_config_t cfg;
@@ -113,12 +153,53 @@ int main(int argc, char **argv) {
         {"sim-step", 666, "INT", 0, "Simulation step in seconds"},
         {"sim-length", 777, "INT", 0, "Length of the simulation in days"},
         {"rand-seed", 888, "INT", 0, "Seed for PRNG. (default time(NULL))"},
+        {"threads", 111111, "INT", 0,
+         "Number of threads for each process (default 1)"},
+        {"balance-every", 121212, "INT", 0,
+         "Steps between load balancing of the countries among processes "
+         "(default 0, never)"},
+        {"compact-migration", 131313, 0, 0,
+         "Send the individuals crossing a border in single precision, with "
+         "positions relative to the destination country"},
+        {"check-every", 141414, "INT", 0,
+         "Steps between checks for the end of the infection (default 1)"},
+        {"checkpoint-every", 191919, "INT", 0,
+         "Steps between checkpoints written to results/checkpoint.bin "
+         "(default 0, never)"},
+        {"restart-from", 202020, "FILE", 0,
+         "Resume the simulation from a checkpoint of the same world"},
+        {"verlet-skin", 212121, "FLOAT", 0,
+         "Skin in meters of the Verlet flags, which skip the exposure checks "
+         "far from the infected individuals (default 0, not used)"},
+        {"exposure-engine", 222222, "ENGINE", 0,
+         "Algorithm finding the infected individuals close to the "
+         "susceptible ones: brute, grid, kdtree, or auto to time them "
+         "periodically in each country (default grid)"},
+        {"swept-exposure", 232323, 0, 0,
+         "Follow the individuals along each step for the exposure, counting "
+         "the time they spend within the spreading distance, instead of "
+         "checking them only at its start"},
+        {"locality-every", 242424, "INT", 0,
+         "Every INT steps, sort along a space-filling curve the individuals "
+         "of the countries whose locality in memory degraded (default 0, "
+         "never)"},
         {0, 0, 0, 0, "Logging options", 5},
         {"log-level", 999, "[TRACE|DEBUG|INFO|WARN|ERROR|FATAL]", 0,
          "Logging level (default INFO)"},
         {"write-trace", 101010, 0, 0,
-         "Write the file results/trace.csv with details about each individual "
-         "at each time step"},
+         "Write the binary file results/trace_{rank}.bin with details about "
+         "each individual at each time step"},
+        {"shared-trace", 151515, 0, 0,
+         "Write the trace to the single binary file results/trace.bin, shared "
+         "by all the processes"},
+        {"trace-every", 161616, "INT", 0,
+         "Write the trace only every INT steps (default 1)"},
+        {"trace-sample-rate", 171717, "FLOAT", 0,
+         "Write the trace only for a random fraction of the individuals, the "
+         "same at each step (default 1)"},
+        {"trace-region", 181818, "XMIN,YMIN,XMAX,YMAX", 0,
+         "Write the trace only for the individuals inside the region (default "
+         "the whole world)"},
         {0},
     };
     /* Define program description */
@@ -128,11 +209,13 @@ int main(int argc, char **argv) {
         " -d float -v float --sim-step seconds --sim-length days ",
         "A simple model for virus spreading.\v"
         "Must be run in an MPI environment where the total number of processes "
-        "is equal to the number of countries (W/w * L/l).\n"
+        "does not exceed the number of countries (W/w * L/l): each process "
+        "owns a rectangular block of countries.\n"
         "Produces a summary in ./results/summary.csv with the number of "
         "susceptible, infected and immune individuals at each time step, and a "
-        "file ./results/trace_{country}.csv for each country if the "
-        "--write-trace flag is given."};
+        "binary file ./results/trace_{rank}.bin for each process if the "
+        "--write-trace flag is given, or ./results/trace.bin if the "
+        "--shared-trace flag is given."};
 
     /* Read command-line options and arguments */
     struct arguments arguments;
@@ -157,764 +240,1484 @@ int main(int argc, char **argv) {
   MPI_Bcast(&cfg, 1, mpi_global_config, 0, MPI_COMM_WORLD);
   /* Set log level */
   log_set_level(cfg.log_level);
-  /* Initialize random number generator */
-  /* NOTE: It is important to give variability between countries */
-  srand(cfg.rand_seed + rank);
-
-  /* Calculate the total number of countries */
-  const unsigned int num_countries =
-      (cfg.world_w / cfg.country_w) * (cfg.world_l / cfg.country_l);
-
-  /* Calculate country limits */
-  limits_t limits = calculate_country_limits(&cfg, num_countries, rank);
-  /* Calculate ranks of neighbors (-1 if none) */
-  int neighbors[NEIGHBOR_COUNT];
-  calculate_neighbors(neighbors, &cfg, num_countries, rank);
-
-  /* Create empty lists of individuals */
-  individual_list_t susceptible_individuals = create_individual_list();
-  individual_list_t infected_individuals = create_individual_list();
-  individual_list_t immune_individuals = create_individual_list();
-  individual_list_t gc_individuals = create_individual_list(); /* recycle bin */
-
-  /* Create buffers to move individuals from/to neighbor countries */
-  individual_t *migrated_out[NEIGHBOR_COUNT] = {NULL};
-  individual_t *migrated_in[NEIGHBOR_COUNT] = {NULL};
-  size_t migrated_out_len[NEIGHBOR_COUNT] = {0};
-  size_t migrated_out_capacity[NEIGHBOR_COUNT] = {0};
-  size_t migrated_in_len[NEIGHBOR_COUNT] = {0};
-  size_t migrated_in_capacity[NEIGHBOR_COUNT] = {0};
-  MPI_Request send_requests[NEIGHBOR_COUNT];
-
-  /* Distribute individuals between countries and initialize them */
-  initialize_individuals(&cfg, num_countries, &susceptible_individuals,
-                         &infected_individuals);
+  /* Set the number of threads */
+  if (cfg.num_threads > 1 && thread_support < MPI_THREAD_FUNNELED) {
+    log_warn("The MPI library does not support threads, using one thread");
+    cfg.num_threads = 1;
+  }
+  omp_set_num_threads(cfg.num_threads);
+  /* Select the distance kernel for the running CPU */
+  const char *kernel_name = init_exposure_kernel();
+  if (rank == ROOT_RANK) {
+    log_info("Using %s exposure kernel", kernel_name);
+  }
+  /* Assign the countries to the processes and create the local ones */
+  /* From now on, the ranks are the ones of the communicator of the domain,
+   * where MPI may have reordered the processes */
+  domain_t domain = create_domain(&cfg, MPI_COMM_WORLD);
+  rank = domain.rank;
+  log_debug("Rank %d -- countries=%d, neighbor processes=%d", rank,
+            domain.num_local, domain.num_neighbor_ranks);
+
+  /* The format of the migrants depends on the configuration */
+  MPI_Datatype mpi_migrant = create_type_mpi_migrant(cfg.compact_migration);
+
+  /* Create buffers to move individuals from/to neighbor processes, with the
+   * part of each neighbor process given by counts and displacements indexed as
+   * in domain.neighbor_ranks */
+  migrant_t *migrated_out = NULL, *migrated_in = NULL;
+  size_t migrated_out_capacity = 0, migrated_in_capacity = 0;
+  size_t migrated_in_len = 0;
+  int *migrated_out_counts = malloc(world_size * sizeof(int));
+  int *migrated_out_displs = malloc(world_size * sizeof(int));
+  int *migrated_in_counts = malloc(world_size * sizeof(int));
+  int *migrated_in_displs = malloc(world_size * sizeof(int));
+  MPI_Request migrated_request;
+  /* Each thread collects the outbound individuals in its own buffers */
+  thread_migration_t *thread_migrations =
+      create_thread_migrations(cfg.num_threads);
+
+  /* Create buffers to share infected individuals close to the borders with
+   * neighbor processes, indexed by rank. Each neighbor process has two
+   * requests: one for the number of ghosts and one for the ghosts themselves */
+  ghost_t **halo_out = calloc(world_size, sizeof(ghost_t *));
+  ghost_t **halo_in = calloc(world_size, sizeof(ghost_t *));
+  size_t *halo_out_len = calloc(world_size, sizeof(size_t));
+  size_t *halo_out_capacity = calloc(world_size, sizeof(size_t));
+  size_t *halo_in_len = calloc(world_size, sizeof(size_t));
+  size_t *halo_in_capacity = calloc(world_size, sizeof(size_t));
+  MPI_Request *halo_requests = malloc(2 * world_size * sizeof(MPI_Request));
+  MPI_Request *halo_recv_requests =
+      malloc(2 * world_size * sizeof(MPI_Request));
+
+  /* Summaries reduced so far, kept on root for the checkpoints:
+   * num_countries for each day */
+  summary_t *summaries = NULL;
+  unsigned long *summary_days = NULL;
+  size_t num_summaries = 0, summaries_capacity = 0, summary_days_capacity = 0;
+  unsigned long t_start = 0, t_last_summary = 0;
+
+  if (cfg.restart_from[0] != '\0') {
+    /* Resume from the state in the checkpoint */
+    if (read_checkpoint(cfg.restart_from, &cfg, &domain, &t_start,
+                        &t_last_summary, &summaries, &summary_days,
+                        &num_summaries) != 0) {
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    summaries_capacity = num_summaries * domain.num_countries;
+    summary_days_capacity = num_summaries;
+    if (rank == ROOT_RANK) {
+      log_info("Resuming from t=%lu", t_start);
+    }
+  } else {
+    /* Distribute individuals between countries and initialize them */
+    unsigned long *num_individuals_by_country =
+        malloc(domain.num_countries * sizeof(unsigned long));
+    unsigned long *num_infected_by_country =
+        malloc(domain.num_countries * sizeof(unsigned long));
+    distribute_population_uniform(cfg.num_individuals, domain.num_countries,
+                                  num_individuals_by_country);
+    distribute_population_uniform(cfg.inf_individuals, domain.num_countries,
+                                  num_infected_by_country);
+    /* The ids are assigned incrementally, in the order of the countries */
+    unsigned long initial_id = 0;
+    for (int c = 0; c < domain.num_countries; c++) {
+      if (domain.local_index[c] >= 0) {
+        initialize_individuals(&cfg, &domain.countries[domain.local_index[c]],
+                               num_individuals_by_country[c],
+                               num_infected_by_country[c], initial_id);
+      }
+      initial_id += num_individuals_by_country[c];
+    }
+    free(num_individuals_by_country);
+    free(num_infected_by_country);
+  }
 
   /* Create directory for results */
   const char res_dir[] = "./results";
   mkdir(res_dir, 0777);
   /* Open trace file */
-  FILE *trace_csv = NULL;
+  trace_t *trace = NULL;
   if (cfg.write_trace) {
-    trace_csv = create_trace_csv(res_dir, rank);
+    trace = create_trace(res_dir, &cfg, domain.comm);
+    if (!trace) {
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
   }
 
-  /* Prepare structures for summary */
-  summary_t summary;
-  FILE *summary_csv = NULL;
-  summary_t *summaries = NULL;
+  /* Prepare structures for summary: each process fills the entries of its
+   * own countries, and they are summed on root while the simulation goes on */
+  summary_t *local_summaries = calloc(domain.num_countries, sizeof(summary_t));
+  writer_t *summary_csv = NULL;
   if (rank == ROOT_RANK) {
-    summary_csv = create_summary_csv(res_dir);
-    summaries = malloc(world_size * sizeof(summary_t));
+    FILE *file = create_summary_csv(res_dir);
+    summary_csv = file ? create_writer(file) : NULL;
+    if (!summary_csv) {
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    /* Write again the days before the checkpoint, if resuming */
+    for (size_t k = 0; k < num_summaries; k++) {
+      summary_csv_write_day(summary_csv, summaries + k * domain.num_countries,
+                            domain.num_countries, summary_days[k]);
+    }
+    writer_flush(summary_csv);
   }
+  /* Path of the checkpoints */
+  char checkpoint_path[PATH_MAX];
+  sprintf(checkpoint_path, "%s/checkpoint.bin", res_dir);
 
   /* -------------------------------------------------------------------------*/
   /* Main loop                                                                */
   /* -------------------------------------------------------------------------*/
-  unsigned long t_last_summary = 0;
+  MPI_Request summary_request = MPI_REQUEST_NULL;
   unsigned long infected_count, total_infected;
-  for (unsigned long t = 0; t_last_summary < cfg.t_target; t += cfg.t_step) {
+  MPI_Request termination_request = MPI_REQUEST_NULL;
+  unsigned long t_termination_check = 0;
+  country_t *country;
+  double start_time, elapsed;
+  locality_stats_t locality_stats = {0, 0, 0., 0., 0., 0., 0.};
+  for (unsigned long t = t_start; t_last_summary < cfg.t_target;
+       t += cfg.t_step) {
     log_debug("Rank %d -- t = %lu", rank, t);
-    /* Update exposure of susceptible individuals */
-    update_exposure(cfg.spreading_distance, &susceptible_individuals,
-                    &infected_individuals);
-
-    /* Write trace to file */
-    if (cfg.write_trace) {
-      trace_csv_write_step(trace_csv, &susceptible_individuals, rank, t);
-      trace_csv_write_step(trace_csv, &infected_individuals, rank, t);
-      trace_csv_write_step(trace_csv, &immune_individuals, rank, t);
-    }
-
-    /* Update the status of all individuals based on t_status and move them
-       into the correct list */
-    update_status(&cfg, &susceptible_individuals, &infected_individuals,
-                  &immune_individuals);
-
-    /* Move the individuals according to the displacement, perform bouncing and
-     * populate the migrated_out buffers */
-    update_position(&cfg, &susceptible_individuals, &gc_individuals,
-                    migrated_out, migrated_out_len, migrated_out_capacity,
-                    &limits, neighbors);
-    update_position(&cfg, &infected_individuals, &gc_individuals, migrated_out,
-                    migrated_out_len, migrated_out_capacity, &limits,
-                    neighbors);
-    update_position(&cfg, &immune_individuals, &gc_individuals, migrated_out,
-                    migrated_out_len, migrated_out_capacity, &limits,
-                    neighbors);
-
-    /* Send out migrated individuals */
-    send_migrated_out(send_requests, migrated_out, migrated_out_len, neighbors,
-                      mpi_individual);
-
-    /* Receive in migrated individuals and insert them into the local lists */
-    receive_migrated_in(migrated_in, migrated_in_len, migrated_in_capacity,
-                        neighbors, mpi_individual);
-    integrate_migrated_in(migrated_in, migrated_in_len, neighbors,
-                          &susceptible_individuals, &infected_individuals,
-                          &immune_individuals, &gc_individuals);
+    /* Pre-post the receives of the number of ghosts that each neighbor
+     * process will send in this step */
+    post_count_receives(&domain, halo_recv_requests, halo_in_len,
+                        HALO_COUNT_TAG);
+
+    /* Exchange the infected individuals close to the borders with neighbors:
+     * the ones for local countries are copied directly */
+    for (int k = 0; k < domain.num_local; k++) {
+      domain.countries[k].halo_len = 0;
+    }
+    for (int k = 0; k < domain.num_local; k++) {
+      update_halo_out(calculate_exposure_reach(&cfg), &domain,
+                      &domain.countries[k], halo_out, halo_out_len,
+                      halo_out_capacity);
+    }
+    send_halo_out(&domain, halo_requests, halo_out, halo_out_len, mpi_ghost);
+
+    /* Update exposure of the susceptible individuals in the interior of the
+     * countries while the ghosts are in flight, measuring the cost of each
+     * country for load balancing and for tuning its exposure engine */
+    for (int k = 0; k < domain.num_local; k++) {
+      country = &domain.countries[k];
+      start_time = MPI_Wtime();
+      update_exposure(&cfg, &domain, country, false);
+      elapsed = MPI_Wtime() - start_time;
+      country->cost += elapsed;
+      country->step_time = elapsed;
+      exposure_index_account(&country->infected_index, elapsed);
+    }
+
+    /* Receive the ghosts from the neighbor processes, then update exposure of
+     * the susceptible individuals close to their borders */
+    receive_halo_in(&cfg, &domain, halo_recv_requests, halo_in, halo_in_len,
+                    halo_in_capacity, mpi_ghost);
+    for (int k = 0; k < domain.num_local; k++) {
+      country = &domain.countries[k];
+      start_time = MPI_Wtime();
+      update_exposure(&cfg, &domain, country, true);
+      elapsed = MPI_Wtime() - start_time;
+      country->cost += elapsed;
+      country->step_time += elapsed;
+      exposure_index_account(&country->infected_index, elapsed);
+    }
+
+    /* Wait until the halo has been sent and reset the buffers */
+    wait_all_requests(halo_requests, 2 * domain.num_neighbor_ranks);
+    memset(halo_out_len, 0, world_size * sizeof(size_t));
+
+    /* Write trace to file, every trace_every steps */
+    if (cfg.write_trace && (t / cfg.t_step) % cfg.trace_every == 0) {
+      for (int k = 0; k < domain.num_local; k++) {
+        country = &domain.countries[k];
+        trace_write_step(trace, &country->population, country->id, t);
+      }
+      trace_end_step(trace, t);
+    }
+
+    /* Move the individuals according to the displacement, perform bouncing
+     * and populate the migrated_out buffers of the countries. The status of
+     * the outbound individuals is updated right away, so they can be sent
+     * before the status of the others */
+    for (int k = 0; k < domain.num_local; k++) {
+      country = &domain.countries[k];
+      start_time = MPI_Wtime();
+      update_position(&cfg, country, thread_migrations);
+      update_migrated_status(&cfg, country);
+      elapsed = MPI_Wtime() - start_time;
+      country->cost += elapsed;
+      country->step_time += elapsed;
+    }
+
+    /* Start the exchange of the individuals migrated to other processes */
+    pack_migrated_out(&domain, &migrated_out, &migrated_out_capacity,
+                      migrated_out_counts, migrated_out_displs);
+    send_migrated_out(&domain, &migrated_request, migrated_out,
+                      migrated_out_counts, migrated_out_displs, &migrated_in,
+                      &migrated_in_len, &migrated_in_capacity,
+                      migrated_in_counts, migrated_in_displs, mpi_migrant);
+
+    /* Update the status of all the other individuals and move them into the
+     * correct range, while the migrated ones are in
+     * flight */
+    for (int k = 0; k < domain.num_local; k++) {
+      country = &domain.countries[k];
+      start_time = MPI_Wtime();
+      update_status(&cfg, &country->population);
+      country->cost += MPI_Wtime() - start_time;
+    }
+
+    /* Insert the individuals migrated between local countries, then the ones
+     * from the neighbor processes once the exchange is complete */
+    move_migrated_local(&cfg, &domain);
+    receive_migrated_in(&cfg, &domain, &migrated_request, migrated_in,
+                        migrated_in_len);
+
+    /* Write the summary of the last day as soon as it has been reduced */
+    complete_summary(&summary_request, false, summary_csv, summaries,
+                     summary_days, num_summaries, domain.num_countries);
 
     /* Send summary if at the end of day */
     /* NOTE: At this point we have computed the situation at t+t_step */
     if (t + cfg.t_step - t_last_summary >= DAY) {
-      /* Prepare summary */
-      INDIVIDUAL_COUNT(&susceptible_individuals, &summary.susceptible);
-      INDIVIDUAL_COUNT(&infected_individuals, &summary.infected);
-      INDIVIDUAL_COUNT(&immune_individuals, &summary.immune);
-      /* Send summary to root */
-      MPI_Gather(&summary, 1, mpi_summary, summaries, 1, mpi_summary, ROOT_RANK,
-                 MPI_COMM_WORLD);
-      /* Write summary to file */
+      /* The summary of the previous day must be complete before reusing the
+       * buffers */
+      complete_summary(&summary_request, true, summary_csv, summaries,
+                       summary_days, num_summaries, domain.num_countries);
+      /* Prepare summary: the countries may have changed owner since the
+       * previous one */
+      memset(local_summaries, 0, domain.num_countries * sizeof(summary_t));
+      for (int k = 0; k < domain.num_local; k++) {
+        country = &domain.countries[k];
+        local_summaries[country->id].susceptible =
+            POPULATION_SUSCEPTIBLE_COUNT(&country->population);
+        local_summaries[country->id].infected =
+            POPULATION_INFECTED_COUNT(&country->population);
+        local_summaries[country->id].immune =
+            POPULATION_IMMUNE_COUNT(&country->population);
+      }
+      /* Make room for the new day on root */
+      summary_t *day_summaries = NULL;
       if (rank == ROOT_RANK) {
-        log_info("Writing summary of day %d", (int)(t_last_summary / DAY));
-        summary_csv_write_day(summary_csv, summaries, world_size,
-                              (int)(t_last_summary / DAY));
-        fflush(summary_csv);
+        size_t target_len = (num_summaries + 1) * domain.num_countries;
+        DYN_ARRAY_EXTEND(summaries, target_len, summaries_capacity, summary_t);
+        DYN_ARRAY_EXTEND(summary_days, num_summaries + 1,
+                         summary_days_capacity, unsigned long);
+        day_summaries = summaries + num_summaries * domain.num_countries;
+        summary_days[num_summaries] = t_last_summary / DAY;
       }
+      num_summaries++;
+      /* Start sending summary to root: summary_t is made of 3 unsigned long,
+       * and the entries of the countries owned by other processes are zero */
+      MPI_Ireduce(local_summaries, day_summaries, 3 * domain.num_countries,
+                  MPI_UNSIGNED_LONG, MPI_SUM, ROOT_RANK, domain.comm,
+                  &summary_request);
       /* Update time of last summary */
       t_last_summary = t + cfg.t_step;
+
+      /* Release the memory of the populations that shrank during the day */
+      for (int k = 0; k < domain.num_local; k++) {
+        population_shrink(&domain.countries[k].population);
+      }
     }
 
-    /* Wait until all send requests have been completed */
-    wait_all_requests(send_requests, neighbors);
-    /* Reset the length of the migrated_out buffers */
-    memset(migrated_out_len, 0, NEIGHBOR_COUNT * sizeof(size_t));
+    /* Periodically sort the populations whose locality degraded, so that the
+     * individuals close in space are close in memory */
+    if (cfg.locality_every > 0) {
+      for (int k = 0; k < domain.num_local; k++) {
+        update_locality(&domain.countries[k],
+                        (t / cfg.t_step + 1) % cfg.locality_every == 0,
+                        &locality_stats);
+      }
+    }
 
-    /* Check the total number of infected individuals in the world */
-    INDIVIDUAL_COUNT(&infected_individuals, &infected_count);
-    MPI_Allreduce(&infected_count, &total_infected, 1, MPI_UNSIGNED_LONG,
-                  MPI_SUM, MPI_COMM_WORLD);
-    /* If there are no more infected individuals, terminate the simulation */
-    if (total_infected == 0) {
-      if (rank == ROOT_RANK) {
-        log_warn("Terminating at t=%lu: No more infected individuals", t);
+    /* Complete the check of the total number of infected individuals in the
+     * world started at a previous step. If there were no more infected
+     * individuals, terminate the simulation: nobody can get infected anymore,
+     * so the steps simulated in the meantime did not change anything */
+    if (termination_request != MPI_REQUEST_NULL) {
+      MPI_Wait(&termination_request, MPI_STATUS_IGNORE);
+      if (total_infected == 0) {
+        if (rank == ROOT_RANK) {
+          log_warn("Terminating at t=%lu: No more infected individuals",
+                   t_termination_check);
+        }
+        break;
       }
-      break;
+    }
+
+    /* Periodically start a new check, which is completed at the next step so
+     * that the reduction does not synchronize the processes */
+    if ((t / cfg.t_step + 1) % cfg.check_every == 0) {
+      infected_count = 0;
+      for (int k = 0; k < domain.num_local; k++) {
+        infected_count +=
+            POPULATION_INFECTED_COUNT(&domain.countries[k].population);
+      }
+      MPI_Iallreduce(&infected_count, &total_infected, 1, MPI_UNSIGNED_LONG,
+                     MPI_SUM, domain.comm, &termination_request);
+      t_termination_check = t;
+    }
+
+    /* Periodically reassign the countries to balance the load */
+    if (cfg.balance_every > 0 &&
+        (t / cfg.t_step + 1) % cfg.balance_every == 0) {
+      balance_domain(&domain, &cfg, t + cfg.t_step, mpi_individual);
+    }
+
+    /* Periodically write a checkpoint, from which the simulation can resume
+     * at the next step. It includes all the summaries so far, so the last
+     * one must be complete */
+    if (cfg.checkpoint_every > 0 &&
+        (t / cfg.t_step + 1) % cfg.checkpoint_every == 0) {
+      complete_summary(&summary_request, true, summary_csv, summaries,
+                       summary_days, num_summaries, domain.num_countries);
+      write_checkpoint(checkpoint_path, &cfg, &domain, t + cfg.t_step,
+                       t_last_summary, summaries, summary_days, num_summaries);
     }
   }
-  /* -------------------------------------------------------------------------*/
-  /* Cleanup                                                                  */
-  /* -------------------------------------------------------------------------*/
-  if (cfg.write_trace) {
-    fclose(trace_csv);
+  /* Complete the last check and summary, if still pending */
+  if (termination_request != MPI_REQUEST_NULL) {
+    MPI_Wait(&termination_request, MPI_STATUS_IGNORE);
   }
-  if (rank == ROOT_RANK) {
-    fclose(summary_csv);
+  complete_summary(&summary_request, true, summary_csv, summaries,
+                   summary_days, num_summaries, domain.num_countries);
+  log_memory_usage(&domain);
+  if (cfg.locality_every > 0) {
+    log_locality_stats(&domain, &locality_stats);
   }
 
-  free_individuals(&susceptible_individuals);
-  free_individuals(&infected_individuals);
-  free_individuals(&immune_individuals);
-  free_individuals(&gc_individuals);
-  free_migrated(migrated_in, neighbors);
-  free_migrated(migrated_out, neighbors);
+  /* -------------------------------------------------------------------------*/
+  /* Cleanup                                                                  */
+  /* -------------------------------------------------------------------------*/
+  free_trace(trace);
+  free_writer(summary_csv);
+
+  free(migrated_in);
+  free(migrated_out);
+  free(migrated_in_counts);
+  free(migrated_in_displs);
+  free(migrated_out_counts);
+  free(migrated_out_displs);
+  free_thread_migrations(thread_migrations, cfg.num_threads);
+  free_halo(halo_in, world_size);
+  free_halo(halo_out, world_size);
+  free(halo_in);
+  free(halo_out);
+  free(halo_in_len);
+  free(halo_in_capacity);
+  free(halo_out_len);
+  free(halo_out_capacity);
+  free(halo_requests);
+  free(halo_recv_requests);
+  free_domain(&domain);
+  free(local_summaries);
   free(summaries);
+  free(summary_days);
 
   MPI_Type_free(&mpi_global_config);
   MPI_Type_free(&mpi_individual);
-  MPI_Type_free(&mpi_summary);
+  MPI_Type_free(&mpi_migrant);
+  MPI_Type_free(&mpi_ghost);
   MPI_Finalize();
   return 0;
 }
 
 /**
- * @brief Distributes individuals between countries and initializes them
+ * @brief Initializes the individuals of a country
  *
- * The population (individuals and infected) defined in the configuration is
- * uniformly distributed among countries. Then each country generates its
- * individuals and assign to each of them:
+ * The country generates its individuals and assign to each of them:
  *  - a random position
  *  - a displacement vector with random direction
  *  - status \c NOT_EXPOSED or \c INFECTED according to the distribution
  *  - <tt>t_status = 0</tt>
  *
- * They are inserted in the correct list according to their status.
+ * They are written directly in the correct range according to their status,
+ * in parallel. The random numbers of each individual are drawn from a
+ * counter-based generator keyed by the seed and by its id, so they do not
+ * depend on the process or on the thread.
  *
  * @param[in] cfg global configuration
- * @param[in] num_countries number of countries
- * @param[out] susceptible_individuals  head of the list where \c NOT_EXPOSED
- * individuals will be inserted
- * @param[out] infected_individuals  head of the list where \c INFECTED
+ * @param[in,out] country country with an empty population, where the
  * individuals will be inserted
+ * @param[in] num_individuals number of individuals of the country
+ * @param[in] num_infected number of initially infected individuals of the
+ * country
+ * @param[in] initial_id id of the first individual of the country
  */
-void initialize_individuals(global_config_t *cfg, int num_countries,
-                            individual_list_t *susceptible_individuals,
-                            individual_list_t *infected_individuals) {
-  int rank;
-  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-  int cols = (cfg->world_w / cfg->country_w);
-  int col = rank % cols;
-  int row = rank / cols;
+void initialize_individuals(global_config_t *cfg, country_t *country,
+                            unsigned long num_individuals,
+                            unsigned long num_infected,
+                            unsigned long initial_id) {
+  log_debug("Country %d -- individuals=%lu, infected=%lu, initial id=%lu",
+            country->id, num_individuals, num_infected, initial_id);
+
+  /* The first num_infected individuals are infected, and go after the
+   * susceptible ones */
+  const unsigned long x_min = country->limits.xmin;
+  const unsigned long y_min = country->limits.ymin;
+  const double step = cfg->t_step * cfg->velocity;
+  population_t *population = &country->population;
+  population_reserve(population, num_individuals);
+  population->len = num_individuals;
+  population->infected_begin = num_individuals - num_infected;
+  population->immune_begin = num_individuals;
 
-  /* Distribute individuals and infected between countries */
-  unsigned long num_individuals, num_infected;
-  if (rank == ROOT_RANK) {
-    unsigned long num_individuals_by_country[num_countries];
-    unsigned long num_infected_by_country[num_countries];
-    distribute_population_uniform(cfg->num_individuals, num_countries,
-                                  num_individuals_by_country);
-    distribute_population_uniform(cfg->inf_individuals, num_countries,
-                                  num_infected_by_country);
-    /* Scatter them among all countries */
-    MPI_Scatter(num_individuals_by_country, 1, MPI_UNSIGNED_LONG,
-                &num_individuals, 1, MPI_UNSIGNED_LONG, ROOT_RANK,
-                MPI_COMM_WORLD);
-    MPI_Scatter(num_infected_by_country, 1, MPI_UNSIGNED_LONG, &num_infected, 1,
-                MPI_UNSIGNED_LONG, ROOT_RANK, MPI_COMM_WORLD);
-  } else {
-    /* Receive the scattered values */
-    MPI_Scatter(NULL, 0, NULL, &num_individuals, 1, MPI_UNSIGNED_LONG,
-                ROOT_RANK, MPI_COMM_WORLD);
-    MPI_Scatter(NULL, 0, NULL, &num_infected, 1, MPI_UNSIGNED_LONG, ROOT_RANK,
-                MPI_COMM_WORLD);
+  /* Initialize each individual */
+#pragma omp parallel for schedule(static)
+  for (unsigned long i = 0; i < num_individuals; i++) {
+    const unsigned long id = i + initial_id;
+    const size_t j = i < num_infected ? population->infected_begin + i
+                                      : i - num_infected;
+    double u[2], v[2];
+    rng_uniform2(cfg->rand_seed, id, 0, u);
+    rng_uniform2(cfg->rand_seed, id, 1, v);
+    const double theta = 2 * M_PI * v[0];
+    population->id[j] = id;
+    population->pos_x[j] = x_min + u[0] * cfg->country_w;
+    population->pos_y[j] = y_min + u[1] * cfg->country_l;
+    population->displ_x[j] = step * cos(theta);
+    population->displ_y[j] = step * sin(theta);
+    population->status[j] = i < num_infected ? INFECTED : NOT_EXPOSED;
+    population->t_status[j] = 0;
+    population->t_motion[j] = 0;
+  }
+  population_schedule(population, 0);
+}
+
+/**
+ * @brief Posts the receives of the number of items that each neighbor process
+ * is going to send
+ *
+ * For each neighbor process \c r = <tt>neighbor_ranks[i]</tt> , a
+ * non-blocking receive into \c counts[r] is posted in \c requests[i] , while
+ * \c requests[num_neighbor_ranks + i] is reset to \c MPI_REQUEST_NULL , to be
+ * used later for the items.
+ *
+ * @param[in] domain domain of this process
+ * @param[out] requests array of at least <tt>2 * num_neighbor_ranks</tt>
+ * requests
+ * @param[out] counts array indexed by rank where the counts will be received
+ * @param[in] tag tag of the count messages
+ */
+void post_count_receives(domain_t *domain, MPI_Request requests[],
+                         size_t counts[], int tag) {
+  const int n = domain->num_neighbor_ranks;
+  int r;
+  for (int i = 0; i < n; i++) {
+    r = domain->neighbor_ranks[i];
+    /* NOTE: size_t is an unsigned long */
+    MPI_Irecv(&counts[r], 1, MPI_UNSIGNED_LONG, r, tag, domain->comm,
+              &requests[i]);
+    requests[n + i] = MPI_REQUEST_NULL;
   }
+}
 
-  /* Determine the id of the first individual for each country */
-  /* The ids are assigned incrementally, so we can perform an exclusive scan */
-  unsigned long initial_id = 0; /* otherwise rank 0 receives undefined */
-  MPI_Exscan(&num_individuals, &initial_id, 1, MPI_UNSIGNED_LONG, MPI_SUM,
-             MPI_COMM_WORLD);
+/**
+ * @brief Collects the infected individuals of a country that can expose
+ * susceptible individuals of neighbor countries
+ *
+ * For each neighbor country, considers the infected individuals within \c
+ * reach from the border (or corner) shared with it. If the
+ * neighbor is owned by this process, their position is appended directly to
+ * its halo; otherwise it is appended to \c halo_out[owner] , only once for
+ * each process.
+ *
+ * @param[in] reach inclusive distance from which an infected individual can
+ * expose, as in calculate_exposure_reach()
+ * @param[in,out] domain domain of this process
+ * @param[in] country local country whose infected individuals are collected
+ * @param[in,out] halo_out buffer indexed by rank where to put the outbound
+ * ghosts, each position must be dynamically allocated
+ * @param[in,out] halo_out_len currently used size of the buffer (in number of
+ * ghosts) for each position
+ * @param[in,out] halo_out_capacity current capacity of each position of the
+ * buffer
+ */
+void update_halo_out(double reach, domain_t *domain, country_t *country,
+                     ghost_t *halo_out[], size_t halo_out_len[],
+                     size_t halo_out_capacity[]) {
+  population_t *population = &country->population;
+  limits_t *limits = &country->limits;
+  country_t *neighbor;
+  ghost_t ghost;
+  int n, owner;
+
+  /* Close to border flag: the bits are indexed according to cardinal_point_t */
+  unsigned char near_flag;
+
+  /* Processes the current ghost has already been appended for */
+  int sent_to[NEIGHBOR_COUNT];
+  int num_sent;
+
+  for (size_t j = population->infected_begin; j < population->immune_begin;
+       j++) {
+    ghost.pos[0] = population->pos_x[j];
+    ghost.pos[1] = population->pos_y[j];
+    ghost.displ[0] = population->displ_x[j];
+    ghost.displ[1] = population->displ_y[j];
+
+    near_flag = 0;
+    if (ghost.pos[0] - limits->xmin <= reach) {
+      near_flag |= 1 << WEST;
+    }
+    if (limits->xmax - ghost.pos[0] <= reach) {
+      near_flag |= 1 << EAST;
+    }
+    if (ghost.pos[1] - limits->ymin <= reach) {
+      near_flag |= 1 << SOUTH;
+    }
+    if (limits->ymax - ghost.pos[1] <= reach) {
+      near_flag |= 1 << NORTH;
+    }
+    if (!near_flag) {
+      continue;
+    }
 
-  log_debug("Rank %d -- individuals=%lu, infected=%lu, initial id=%lu", rank,
-            num_individuals, num_infected, initial_id);
+    /* Each neighbor whose directions are all in the flag shares the border */
+    num_sent = 0;
+    for (int i = 0; i < NEIGHBOR_COUNT; i++) {
+      n = country->neighbors[i];
+      if (n < 0 || (near_flag & encode_cardinal_point_flag(i)) !=
+                       encode_cardinal_point_flag(i)) {
+        continue;
+      }
+      if (domain->local_index[n] >= 0) {
+        /* Same process: copy into the halo of the neighbor */
+        neighbor = &domain->countries[domain->local_index[n]];
+        DYN_ARRAY_APPEND(ghost, neighbor->halo, neighbor->halo_len,
+                         neighbor->halo_capacity, ghost_t);
+      } else {
+        /* The receiver finds all of its countries the ghost is relevant to */
+        owner = domain->owner[n];
+        int k = 0;
+        while (k < num_sent && sent_to[k] != owner) {
+          k++;
+        }
+        if (k == num_sent) {
+          DYN_ARRAY_APPEND(ghost, halo_out[owner], halo_out_len[owner],
+                           halo_out_capacity[owner], ghost_t);
+          sent_to[num_sent++] = owner;
+        }
+      }
+    }
+  }
+}
 
-  /* Initialize each individual */
-  const unsigned long x_min = col * cfg->country_w;
-  const unsigned long y_min = row * cfg->country_l;
-  individual_t *ind;
-  double theta;
-  for (unsigned long i = 0; i < num_individuals; i++) {
-    ind = malloc(sizeof(individual_t));
-    ind->id = i + initial_id;
-    ind->t_status = 0;
-    ind->pos[0] = RAND_DOUBLE(x_min, cfg->country_w);
-    ind->pos[1] = RAND_DOUBLE(y_min, cfg->country_l);
-    theta = RAND_DOUBLE(0, 2 * M_PI);
-    ind->displ[0] = cfg->t_step * cfg->velocity * cos(theta);
-    ind->displ[1] = cfg->t_step * cfg->velocity * sin(theta);
-
-    /* Set status and insert into correct list */
-    if (i < num_infected) {
-      ind->status = INFECTED;
-      INDIVIDUAL_INSERT(infected_individuals, ind);
-    } else {
-      ind->status = NOT_EXPOSED;
-      INDIVIDUAL_INSERT(susceptible_individuals, ind);
+/**
+ * @brief Appends the ghosts received from a neighbor process to the halo of
+ * the local countries they are relevant to
+ *
+ * A ghost is relevant to each country within the reach of the exposure from it,
+ * which are searched among the countries around its position.
+ *
+ * @param[in] cfg global configuration
+ * @param[in,out] domain domain of this process
+ * @param[in] halo_in ghosts received from the neighbor process
+ * @param[in] halo_in_len number of ghosts
+ */
+void integrate_halo_in(global_config_t *cfg, domain_t *domain,
+                       ghost_t halo_in[], size_t halo_in_len) {
+  const double d = calculate_exposure_reach(cfg);
+  const long cols = (cfg->world_w / cfg->country_w);
+  const long rows = (cfg->world_l / cfg->country_l);
+  long col_min, col_max, row_min, row_max;
+  country_t *country;
+  ghost_t *ghost;
+  int k;
+
+  for (size_t j = 0; j < halo_in_len; j++) {
+    ghost = &halo_in[j];
+    /* Candidate countries, with one more on each side to be safe from the
+     * rounding of the divisions */
+    col_min = MAX((long)floor((ghost->pos[0] - d) / cfg->country_w) - 1, 0);
+    col_max =
+        MIN((long)floor((ghost->pos[0] + d) / cfg->country_w) + 1, cols - 1);
+    row_min = MAX((long)floor((ghost->pos[1] - d) / cfg->country_l) - 1, 0);
+    row_max =
+        MIN((long)floor((ghost->pos[1] + d) / cfg->country_l) + 1, rows - 1);
+    for (long row = row_min; row <= row_max; row++) {
+      for (long col = col_min; col <= col_max; col++) {
+        k = domain->local_index[row * cols + col];
+        if (k < 0) {
+          continue;
+        }
+        country = &domain->countries[k];
+        if (country_is_near(country, ghost->pos[0], ghost->pos[1], d)) {
+          DYN_ARRAY_APPEND(*ghost, country->halo, country->halo_len,
+                           country->halo_capacity, ghost_t);
+        }
+      }
     }
   }
 }
 
 /**
- * @brief Frees a dynamically allocated list of individuals
+ * @brief Computes the Verlet flags of the susceptible individuals of a country
+ *
+ * An individual is flagged if there is at least one infected individual within
+ * \c reach plus the skin. A local infected individual that was farther cannot
+ * get within \c reach until the skin has been covered, so the flags stay
+ * valid for \c verlet_steps steps, as long as no individual joins the infected
+ * range.
  *
- * @param individuals list of individuals
+ * @pre The infected individuals have been inserted into the index of the
+ * country
+ * @post No individuals have joined the infected range since the flags were
+ * computed
+ *
+ * @param[in] reach inclusive distance from which an infected individual can
+ * expose, as in calculate_exposure_reach()
+ * @param[in,out] country
  */
-void free_individuals(individual_list_t *individuals) {
-  individual_t *ind, *next;
-  ind = INDIVIDUAL_FIRST(individuals);
-  while (ind) {
-    next = INDIVIDUAL_NEXT(ind);
-    free(ind);
-    ind = next;
+void update_verlet_flags(double reach, country_t *country) {
+  population_t *population = &country->population;
+  exposure_index_t *infected_index = &country->infected_index;
+  const double radius = reach + country->verlet_skin;
+
+  if (infected_index->len == 0) {
+    memset(population->verlet, 0, population->infected_begin);
+  } else {
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t i = 0; i < population->infected_begin; i++) {
+      population->verlet[i] = exposure_index_any_within(
+          infected_index, population->pos_x[i], population->pos_y[i], radius);
+    }
   }
+  population->joined_infected = 0;
+  country->verlet_age = 0;
 }
 
 /**
- * @brief Compute the exposure status of susceptible individuals
+ * @brief Compute the exposure status of the susceptible individuals in the
+ * interior or close to the border of a country
+ *
+ * The infected individuals, both local and in the halo of the country, are
+ * inserted into the exposure index of the country, which is searched for each
+ * susceptible individual with the engine chosen for this step: the grid
+ * checks only the cell of the individual and the 8 surrounding ones, the
+ * 2-d tree the branches close to it, and the brute force all of them.
+ *
+ * The border of the country is the band within twice the reach of the exposure
+ * from the neighbors owned by other processes (twice, to be safe from
+ * rounding), and the interior is the rest. The interior can be updated before
+ * the ghosts from the other processes are received; the border is updated
+ * afterwards, indexing the infected individuals again if new ghosts arrived.
+ *
+ * If the Verlet flags are used, the individuals that are not flagged and are
+ * in neither band (so that no ghost can reach them) are not checked at all.
+ * The flags are computed again in the interior pass when they expire.
+ *
+ * If the exposure is swept, the individuals are followed along the step as if
+ * they moved linearly, and each exposed individual also accrues in \c
+ * t_status the time it spends within \c spreading_distance from any infected
+ * individual, rounded to seconds. The reach of the exposure then includes the
+ * largest approach in a step.
  *
  * @pre All susceptible individuals have <tt>status = NOT_EXPOSED<\tt>
- * @post Each susceptible individual is flagged as \c EXPOSED if there is at
- * least one \c INFECTED individual in a \c spreading_distance radius from him;
- * otherwise it remains \c NOT_EXPOSED . No items are inserted or removed from
- * the lists.
- *
- * @param[in] spreading_distance inclusive distance to be considered exposed
- * @param[in,out] susceptible_individuals list of all susceptible individuals
- * @param[in] infected_individuals list of all infected individuals
+ * @post Each susceptible individual of the given part is flagged as \c
+ * EXPOSED if there is at least one \c INFECTED individual in a \c
+ * spreading_distance radius from him, even across the border; otherwise it
+ * remains \c NOT_EXPOSED . No individuals are inserted, removed or moved in
+ * the population.
+ *
+ * @param[in] cfg global configuration
+ * @param[in] domain domain of this process
+ * @param[in,out] country country whose halo has been filled, at least with
+ * the ghosts from the local countries
+ * @param[in] border whether to update the border instead of the interior
  */
-void update_exposure(double spreading_distance,
-                     individual_list_t *susceptible_individuals,
-                     individual_list_t *infected_individuals) {
-  individual_t *i, *j;
-  /* We check each susceptible individual against infected individual */
-  INDIVIDUAL_FOREACH(i, susceptible_individuals) {
-    INDIVIDUAL_FOREACH(j, infected_individuals) {
-      if (INDIVIDUAL_DISTANCE(i, j) <= spreading_distance) {
-        /* As soon as one match is found, we can go on to the next i */
-        i->status = EXPOSED;
-        break;
+void update_exposure(global_config_t *cfg, domain_t *domain,
+                     country_t *country, bool border) {
+  population_t *population = &country->population;
+  limits_t *limits = &country->limits;
+  exposure_index_t *infected_index = &country->infected_index;
+  const double spreading_distance = cfg->spreading_distance;
+  const double reach = calculate_exposure_reach(cfg);
+  const double band = 2 * reach;
+
+  /* Index the local and neighboring infected individuals, if not already
+   * done with the same ghosts */
+  if (!border) {
+    exposure_index_step(infected_index);
+  }
+  if (!border || infected_index->len != POPULATION_INFECTED_COUNT(population) +
+                                           country->halo_len) {
+    exposure_index_reset(infected_index);
+    for (size_t j = population->infected_begin; j < population->immune_begin;
+         j++) {
+      exposure_index_insert(infected_index, population->pos_x[j],
+                            population->pos_y[j], population->displ_x[j],
+                            population->displ_y[j]);
+    }
+    for (size_t k = 0; k < country->halo_len; k++) {
+      ghost_t *ghost = &country->halo[k];
+      exposure_index_insert(infected_index, ghost->pos[0], ghost->pos[1],
+                            ghost->displ[0], ghost->displ[1]);
+    }
+    if (infected_index->len > 0) {
+      exposure_index_build(infected_index);
+    }
+  }
+  /* Only the local infected individuals matter for the flags, while the
+   * ghosts are handled by the bands */
+  const bool verlet = country->verlet_skin > 0.;
+  if (verlet && !border &&
+      (++country->verlet_age > country->verlet_steps ||
+       population->joined_infected > 0)) {
+    update_verlet_flags(reach, country);
+  }
+  /* Nobody can be exposed if there are no infected individuals */
+  if (infected_index->len == 0) {
+    return;
+  }
+
+  /* Directions of the neighbors owned by other processes, as flags */
+  unsigned char remote_flags[NEIGHBOR_COUNT];
+  int num_remote = 0;
+  for (int i = 0; i < NEIGHBOR_COUNT; i++) {
+    int n = country->neighbors[i];
+    if (n >= 0 && domain->local_index[n] < 0) {
+      remote_flags[num_remote++] = encode_cardinal_point_flag(i);
+    }
+  }
+
+  /* We check each susceptible individual against the close infected ones */
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (size_t i = 0; i < population->infected_begin; i++) {
+    double x = population->pos_x[i], y = population->pos_y[i];
+    /* Close to border flag, as in update_halo_out() */
+    unsigned char near_flag = 0;
+    if (x - limits->xmin <= band) {
+      near_flag |= 1 << WEST;
+    }
+    if (limits->xmax - x <= band) {
+      near_flag |= 1 << EAST;
+    }
+    if (y - limits->ymin <= band) {
+      near_flag |= 1 << SOUTH;
+    }
+    if (limits->ymax - y <= band) {
+      near_flag |= 1 << NORTH;
+    }
+    bool in_border = false;
+    for (int k = 0; k < num_remote && !in_border; k++) {
+      in_border = (near_flag & remote_flags[k]) == remote_flags[k];
+    }
+    if (in_border != border ||
+        (verlet && !population->verlet[i] && near_flag == 0)) {
+      continue;
+    }
+    if (cfg->swept_exposure) {
+      double within = exposure_index_time_within(
+          infected_index, x, y, population->displ_x[i],
+          population->displ_y[i], spreading_distance);
+      if (within > 0.) {
+        population->status[i] = EXPOSED;
+        population->t_status[i] += lround(within * cfg->t_step);
       }
+    } else if (exposure_index_any_within(infected_index, x, y,
+                                         spreading_distance)) {
+      population->status[i] = EXPOSED;
     }
   }
 }
 
 /**
- * @brief Updates the status of each individual in the given lists and moves it
- * to the correct list
+ * @brief Calculates the status of an individual after one step
  *
- * @pre All indivuduals are in the correct list according to their status.
- * All \c susceptible_individuals that are actually exposed have
- * <tt>status == EXPOSED</tt>
- *
- * @post All individuals are in the correct list according to their status.
- * All \c susceptible_individuals have \c status reset to \c NOT_EXPOSED.
  * If the individual was \c NOT_EXPOSED , \c t_status is reset to zero.
- * In all other cases \c t_status is incremented by \c t_step , except if there
- * is a status change, where it is reset to zero.
+ * In all other cases \c t_status is incremented by \c t_step , except if
+ * there is a status change, where it is reset to zero. An \c EXPOSED
+ * individual that does not get infected goes back to \c NOT_EXPOSED . With
+ * the swept exposure, an \c EXPOSED individual has already accrued its time
+ * in range instead of \c t_step .
  *
  * @param[in] cfg global configuration
- * @param[in,out] susceptible_individuals list of all susceptible individuals
- * @param[in,out] infected_individuals list of all infected individuals
- * @param[in,out] immune_individuals list of all immune individuals
+ * @param[in] status current status, as in \c individual_status_t
+ * @param[in,out] t_status time passed since entering the current status
+ * @return unsigned char the new status
  */
-void update_status(global_config_t *cfg,
-                   individual_list_t *susceptible_individuals,
-                   individual_list_t *infected_individuals,
-                   individual_list_t *immune_individuals) {
-  /* Save the first element of each list, so we don't re-process elements that
-   * are inserted in the meantime */
-  individual_t *sus = INDIVIDUAL_FIRST(susceptible_individuals);
-  individual_t *inf = INDIVIDUAL_FIRST(infected_individuals);
-  individual_t *imm = INDIVIDUAL_FIRST(immune_individuals);
-  individual_t *prev, *next;
-
-  /* susceptible -> Infected */
-  prev = NULL;
-  while (sus) {
-    next = INDIVIDUAL_NEXT(sus);
-    if (sus->status == EXPOSED) { /* EXPOSED */
-      sus->t_status += cfg->t_step;
-      if (sus->t_status >= cfg->t_infection) {
+unsigned char next_status(global_config_t *cfg, unsigned char status,
+                          unsigned long *t_status) {
+  switch (status) {
+    case EXPOSED: { /* susceptible -> Infected */
+      if (!cfg->swept_exposure) {
+        *t_status += cfg->t_step;
+      }
+      if (*t_status >= cfg->t_infection) {
         /* The individual becomes infected */
-        sus->status = INFECTED;
-        sus->t_status = 0;
-        /* Remove it from the current list */
-        if (prev) {
-          INDIVIDUAL_REMOVE_AFTER(prev);
-        } else {
-          INDIVIDUAL_REMOVE_HEAD(susceptible_individuals);
-        }
-        /* Put it in the other list */
-        INDIVIDUAL_INSERT(infected_individuals, sus);
-      } else {
-        sus->status = NOT_EXPOSED;
-        /* If we didn't move the current element, we can advance prev */
-        prev = sus;
+        *t_status = 0;
+        return INFECTED;
       }
-    } else { /* NOT_EXPOSED */
-      sus->t_status = 0;
-      prev = sus;
-    }
-    sus = next;
-  }
-
-  /* Infected -> Immune */
-  prev = NULL;
-  while (inf) {
-    next = INDIVIDUAL_NEXT(inf);
-    inf->t_status += cfg->t_step;
-    if (inf->t_status >= cfg->t_recovery) {
-      /* The individual becomes immune */
-      inf->status = IMMUNE;
-      inf->t_status = 0;
-      /* Remove it from the current list */
-      if (prev) {
-        INDIVIDUAL_REMOVE_AFTER(prev);
-      } else {
-        INDIVIDUAL_REMOVE(infected_individuals, inf);
+      return NOT_EXPOSED;
+    }
+    case INFECTED: { /* Infected -> Immune */
+      *t_status += cfg->t_step;
+      if (*t_status >= cfg->t_recovery) {
+        /* The individual becomes immune */
+        *t_status = 0;
+        return IMMUNE;
       }
-      /* Put it in the other list */
-      INDIVIDUAL_INSERT(immune_individuals, inf);
-    } else {
-      /* If we didn't move the current element, we can advance prev */
-      prev = inf;
-    }
-    inf = next;
-  }
-
-  /* Immune -> susceptible */
-  prev = NULL;
-  while (imm) {
-    next = INDIVIDUAL_NEXT(imm);
-    imm->t_status += cfg->t_step;
-    if (imm->t_status >= cfg->t_immunity) {
-      /* The individual becomes susceptible again */
-      imm->status = NOT_EXPOSED;
-      imm->t_status = 0;
-      /* Remove it from the current list */
-      if (prev) {
-        INDIVIDUAL_REMOVE_AFTER(prev);
-      } else {
-        INDIVIDUAL_REMOVE(immune_individuals, imm);
+      return INFECTED;
+    }
+    case IMMUNE: { /* Immune -> susceptible */
+      *t_status += cfg->t_step;
+      if (*t_status >= cfg->t_immunity) {
+        /* The individual becomes susceptible again */
+        *t_status = 0;
+        return NOT_EXPOSED;
       }
-      /* Put it in the other list */
-      INDIVIDUAL_INSERT(susceptible_individuals, imm);
-    } else {
-      /* If we didn't move the current element, we can advance prev */
-      prev = imm;
+      return IMMUNE;
+    }
+    default: { /* NOT_EXPOSED */
+      *t_status = 0;
+      return NOT_EXPOSED;
     }
-    imm = next;
   }
 }
 
 /**
- * @brief Updates the position of each individual in a list and moves
- * individuals that exited the country to an outbound buffer
+ * @brief Updates the status of each individual in the population and moves it
+ * to the correct range
+ *
+ * Only the susceptible individuals are visited, in parallel: the transitions
+ * of the infected and immune ones are scheduled, and performed by \c
+ * population_advance() when due.
+ *
+ * @pre All indivuduals are in the correct range according to their status.
+ * All susceptible individuals that are actually exposed have
+ * <tt>status == EXPOSED</tt>
+ *
+ * @post All individuals are in the correct range according to their status,
+ * which is updated as in \c next_status() . All susceptible individuals have
+ * \c status reset to \c NOT_EXPOSED.
  *
  * @param[in] cfg global configuration
- * @param[in,out] individuals list of individuals to be processed
- * @param[in,out] gc_individuals list of garbage-collected individuals
- * @param[in,out] migrated_out buffer indexed by cardinal point where to put
- * outbound individuals, each position must be dynamically allocated
- * @param[in,out] migrated_out_len currently used size of the buffer (in number
- * of individuals) for each position
- * @param[in,out] migrated_out_capacity current capacity of each position of the
- * buffer
- * @param[in] limits limits of the country
- * @param[in] neighbors array of indinces of neighbor countries, one for each of
- * the eight cardinal directions
+ * @param[in,out] population population of the country
  */
-void update_position(global_config_t *cfg, individual_list_t *individuals,
-                     individual_list_t *gc_individuals,
-                     individual_t *migrated_out[], size_t migrated_out_len[],
-                     size_t migrated_out_capacity[], limits_t *limits,
-                     int neighbors[]) {
-  individual_t *ind, *prev, *next;
+void update_status(global_config_t *cfg, population_t *population) {
+  unsigned char *status = population->status;
+  unsigned long *t_status = population->t_status;
+
+  /* The status of the susceptible individuals is changed in place */
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < population->infected_begin; i++) {
+    status[i] = next_status(cfg, status[i], &t_status[i]);
+  }
 
-  /* Out of bound flag: the bits are indexed according to cardinal_point_t */
-  unsigned char out_flag;
+  /* Perform the due transitions and move the individuals whose status changed
+   * into the correct range */
+  population_advance(population, cfg->t_step, cfg->t_recovery,
+                     cfg->t_immunity);
+}
 
-  /* Cardinal point of the destination country */
-  int dest;
+/**
+ * @brief Updates the status of the individuals in the outbound buffers of a
+ * country, as \c update_status() does for the ones in the population
+ *
+ * @param[in] cfg global configuration
+ * @param[in,out] country country whose outbound buffers have just been filled
+ */
+void update_migrated_status(global_config_t *cfg, country_t *country) {
+  migrant_t *m;
+  unsigned long t_status;
+  unsigned char status;
+  for (int i = 0; i < NEIGHBOR_COUNT; i++) {
+    for (size_t j = 0; j < country->migrated_out_len[i]; j++) {
+      m = &country->migrated_out[i][j];
+      t_status = MIGRANT_T_STATUS(m);
+      status = next_status(cfg, MIGRANT_STATUS(m), &t_status);
+      m->status_timer = MIGRANT_PACK_STATUS(status, t_status);
+    }
+  }
+}
 
-  /* Iterate over the list */
-  ind = INDIVIDUAL_FIRST(individuals);
-  prev = NULL;
-  while (ind) {
-    out_flag = 0;
-    next = INDIVIDUAL_NEXT(ind);
-
-    /* Move of the given displacement */
-    ind->pos[0] += ind->displ[0];
-    ind->pos[1] += ind->displ[1];
-
-    /* Calculate residuals w.r.t the boundaries */
-    double res_xmin = ind->pos[0] - limits->xmin;
-    double res_xmax = ind->pos[0] - limits->xmax;
-    double res_ymin = ind->pos[1] - limits->ymin;
-    double res_ymax = ind->pos[1] - limits->ymax;
-
-    /* Check if out-of-bound horizontally */
-    if (res_xmin < 0) { /* West */
-      if (neighbors[WEST] < 0) {
-        /* Out of world => bounce */
-        ind->pos[0] += -2 * res_xmin;
-        ind->displ[0] = -ind->displ[0];
-      } else {
-        out_flag += 1 << WEST;
+/**
+ * @brief Updates the position of each individual in a country and moves
+ * individuals that exited the country to its outbound buffers
+ *
+ * The individuals are processed in parallel: each thread collects the outbound
+ * individuals in its own buffers, which are merged at the end. The immune
+ * individuals are not moved, only the ones whose exit from the country is
+ * due are popped and moved to the outbound buffers.
+ *
+ * @param[in] cfg global configuration
+ * @param[in,out] country country whose individuals are moved
+ * @param[in,out] thread_migrations array of empty per-thread buffers, one for
+ * each of the \c num_threads threads
+ */
+void update_position(global_config_t *cfg, country_t *country,
+                     thread_migration_t *thread_migrations) {
+  population_t *population = &country->population;
+  limits_t *limits = &country->limits;
+  int *neighbors = country->neighbors;
+  double *pos_x = population->pos_x, *pos_y = population->pos_y;
+  double *displ_x = population->displ_x, *displ_y = population->displ_y;
+
+  /* Limits of the neighbors, for the compact format of the migrants */
+  limits_t neighbor_limits[NEIGHBOR_COUNT];
+  for (int i = 0; i < NEIGHBOR_COUNT; i++) {
+    if (neighbors[i] >= 0) {
+      neighbor_limits[i] = calculate_country_limits(cfg, 0, neighbors[i]);
+    }
+  }
+
+#pragma omp parallel
+  {
+    thread_migration_t *tm = &thread_migrations[omp_get_thread_num()];
+    migrant_t m;
+
+    /* Out of bound flag: the bits are indexed according to cardinal_point_t */
+    unsigned char out_flag;
+
+    /* Cardinal point of the destination country */
+    int dest;
+
+    /* Static scheduling gives each thread an ascending range of indices */
+  #pragma omp for schedule(static)
+    for (size_t i = 0; i < population->immune_begin; i++) {
+      out_flag = 0;
+
+      /* Move of the given displacement */
+      pos_x[i] += displ_x[i];
+      pos_y[i] += displ_y[i];
+
+      /* Calculate residuals w.r.t the boundaries */
+      double res_xmin = pos_x[i] - limits->xmin;
+      double res_xmax = pos_x[i] - limits->xmax;
+      double res_ymin = pos_y[i] - limits->ymin;
+      double res_ymax = pos_y[i] - limits->ymax;
+
+      /* Check if out-of-bound horizontally */
+      if (res_xmin < 0) { /* West */
+        if (neighbors[WEST] < 0) {
+          /* Out of world => bounce */
+          pos_x[i] += -2 * res_xmin;
+          displ_x[i] = -displ_x[i];
+        } else {
+          out_flag += 1 << WEST;
+        }
+      } else if (res_xmax >= 0) { /* East */
+        if (neighbors[EAST] < 0) {
+          /* Out of world => bounce */
+          pos_x[i] += -2 * res_xmax;
+          displ_x[i] = -displ_x[i];
+        } else {
+          out_flag += 1 << EAST;
+        }
       }
-    } else if (res_xmax >= 0) { /* East */
-      if (neighbors[EAST] < 0) {
-        /* Out of world => bounce */
-        ind->pos[0] += -2 * res_xmax;
-        ind->displ[0] = -ind->displ[0];
-      } else {
-        out_flag += 1 << EAST;
+
+      /* Check if out-of-bound vertically */
+      if (res_ymin < 0) { /* South */
+        if (neighbors[SOUTH] < 0) {
+          /* Out of world => bounce */
+          pos_y[i] += -2 * res_ymin;
+          displ_y[i] = -displ_y[i];
+        } else {
+          out_flag += 1 << SOUTH;
+        }
+      } else if (res_ymax >= 0) { /* North */
+        if (neighbors[NORTH] < 0) {
+          /* Out of world => bounce */
+          pos_y[i] += -2 * res_ymax;
+          displ_y[i] = -displ_y[i];
+        } else {
+          out_flag += 1 << NORTH;
+        }
+      }
+
+      /* Send out-of-bound individuals to another country */
+      if (out_flag) {
+        /* Determine destionation */
+        dest = decode_cardinal_point_flag(out_flag);
+        /* Pack into the migration buffer of the thread */
+        population_get_migrant(population, i, neighbors[dest],
+                               &neighbor_limits[dest], cfg->compact_migration,
+                               &m);
+        DYN_ARRAY_APPEND(m, tm->migrated_out[dest], tm->migrated_out_len[dest],
+                         tm->migrated_out_capacity[dest], migrant_t);
+        /* Remember to remove it from the local population */
+        DYN_ARRAY_APPEND(i, tm->removed, tm->removed_len, tm->removed_capacity,
+                         size_t);
       }
     }
+  }
 
-    /* Check if out-of-bound vertically */
-    if (res_ymin < 0) { /* South */
-      if (neighbors[SOUTH] < 0) {
-        /* Out of world => bounce */
-        ind->pos[1] += -2 * res_ymin;
-        ind->displ[1] = -ind->displ[1];
-      } else {
-        out_flag += 1 << SOUTH;
+  /* Merge the buffers of all threads and remove the outbound individuals */
+  merge_thread_migrations(thread_migrations, cfg->num_threads, population,
+                          country->migrated_out, country->migrated_out_len,
+                          country->migrated_out_capacity);
+
+  /* Move the immune individuals leaving the country in this step */
+  size_t i;
+  int dest;
+  migrant_t m;
+  while (population_pop_exit(population, &i, &dest)) {
+    population_get_migrant(population, i, neighbors[dest],
+                           &neighbor_limits[dest], cfg->compact_migration, &m);
+    DYN_ARRAY_APPEND(m, country->migrated_out[dest],
+                     country->migrated_out_len[dest],
+                     country->migrated_out_capacity[dest], migrant_t);
+    population_remove(population, i);
+  }
+}
+
+/**
+ * @brief Packs the individuals that left each local country towards a country
+ * owned by another process into a single outbound buffer
+ *
+ * The individuals are grouped by owner, in the order of \c neighbor_ranks ,
+ * and the corresponding outbound buffers of the countries are emptied.
+ *
+ * @param[in,out] domain domain of this process
+ * @param[in,out] migrated_out dynamically allocated buffer where to put the
+ * outbound individuals, extended if necessary
+ * @param[in,out] migrated_out_capacity current capacity of the buffer
+ * @param[out] send_counts number of individuals for each neighbor process
+ * @param[out] send_displs displacement in the buffer of the individuals for
+ * each neighbor process
+ */
+void pack_migrated_out(domain_t *domain, migrant_t **migrated_out,
+                       size_t *migrated_out_capacity, int send_counts[],
+                       int send_displs[]) {
+  const int num_neighbor_ranks = domain->num_neighbor_ranks;
+  country_t *country;
+  size_t len, total = 0;
+  int n, i_owner;
+
+  /* Count the individuals for each neighbor process */
+  memset(send_counts, 0, num_neighbor_ranks * sizeof(int));
+  for (int k = 0; k < domain->num_local; k++) {
+    country = &domain->countries[k];
+    for (int i = 0; i < NEIGHBOR_COUNT; i++) {
+      n = country->neighbors[i];
+      if (n >= 0 && domain->local_index[n] < 0) {
+        send_counts[domain->neighbor_index[domain->owner[n]]] +=
+            country->migrated_out_len[i];
       }
-    } else if (res_ymax >= 0) { /* North */
-      if (neighbors[NORTH] < 0) {
-        /* Out of world => bounce */
-        ind->pos[1] += -2 * res_ymax;
-        ind->displ[1] = -ind->displ[1];
-      } else {
-        out_flag += 1 << NORTH;
+    }
+  }
+  for (int j = 0; j < num_neighbor_ranks; j++) {
+    send_displs[j] = total;
+    total += send_counts[j];
+  }
+  DYN_ARRAY_EXTEND(*migrated_out, total, *migrated_out_capacity, migrant_t);
+
+  /* Append the whole buffer of each country to the part of the owner, using
+   * the counts as cursors */
+  memset(send_counts, 0, num_neighbor_ranks * sizeof(int));
+  for (int k = 0; k < domain->num_local; k++) {
+    country = &domain->countries[k];
+    for (int i = 0; i < NEIGHBOR_COUNT; i++) {
+      n = country->neighbors[i];
+      len = country->migrated_out_len[i];
+      if (n < 0 || len == 0 || domain->local_index[n] >= 0) {
+        continue;
       }
+      i_owner = domain->neighbor_index[domain->owner[n]];
+      memcpy(*migrated_out + send_displs[i_owner] + send_counts[i_owner],
+             country->migrated_out[i], len * sizeof(migrant_t));
+      send_counts[i_owner] += len;
+      country->migrated_out_len[i] = 0;
     }
+  }
+}
 
-    /* Send out-of-bound individuals to another country */
-    if (out_flag) {
-      /* Determine destionation */
-      dest = decode_cardinal_point_flag(out_flag);
-      /* Remove from local list */
-      if (prev) {
-        INDIVIDUAL_REMOVE_AFTER(prev);
-      } else {
-        INDIVIDUAL_REMOVE_HEAD(individuals);
+/**
+ * @brief Inserts the individuals that left each local country towards another
+ * local country into the population of the destination
+ *
+ * This is an in-memory move, with no communication, but the records go
+ * through the same format as the ones sent to other processes, so the results
+ * do not depend on the assignment of the countries. The outbound buffers of
+ * the countries are emptied.
+ *
+ * @param[in] cfg global configuration
+ * @param[in,out] domain domain of this process
+ */
+void move_migrated_local(global_config_t *cfg, domain_t *domain) {
+  country_t *country, *dest;
+  int n;
+  for (int k = 0; k < domain->num_local; k++) {
+    country = &domain->countries[k];
+    for (int i = 0; i < NEIGHBOR_COUNT; i++) {
+      n = country->neighbors[i];
+      if (n < 0 || domain->local_index[n] < 0) {
+        continue;
       }
-      /* Copy to migration buffer */
-      DYN_ARRAY_APPEND(*ind, migrated_out[dest], migrated_out_len[dest],
-                       migrated_out_capacity[dest], individual_t);
-      /* Insert old list element into garbage collection list to be reused */
-      INDIVIDUAL_INSERT(gc_individuals, ind);
-    } else {
-      /* If we didn't remove the current element, we can advance prev */
-      prev = ind;
+      dest = &domain->countries[domain->local_index[n]];
+      for (size_t j = 0; j < country->migrated_out_len[i]; j++) {
+        population_insert_migrant(&dest->population,
+                                  &country->migrated_out[i][j], &dest->limits,
+                                  cfg->compact_migration);
+      }
+      country->migrated_out_len[i] = 0;
     }
+  }
+}
 
-    /* Prepare for next iteration */
-    ind = next;
+/**
+ * @brief Starts the exchange of the migrated individuals with all of the
+ * neighbor processes
+ *
+ * The counts are exchanged with a \c MPI_Neighbor_alltoall on the graph
+ * communicator of the domain, then the individuals with a non-blocking \c
+ * MPI_Ineighbor_alltoallv , which must be completed with \c
+ * receive_migrated_in() before touching any of the buffers.
+ *
+ * @param[in] domain domain of this process
+ * @param[out] request request of the exchange
+ * @param[in] migrated_out individuals to be sent, as packed by \c
+ * pack_migrated_out()
+ * @param[in] send_counts number of individuals for each neighbor process
+ * @param[in] send_displs displacement in \c migrated_out of the individuals
+ * for each neighbor process
+ * @param[in,out] migrated_in dynamically allocated buffer where to receive the
+ * individuals, extended if necessary
+ * @param[out] migrated_in_len total number of individuals to be received
+ * @param[in,out] migrated_in_capacity current capacity of \c migrated_in
+ * @param[out] recv_counts number of individuals from each neighbor process
+ * @param[out] recv_displs displacement in \c migrated_in of the individuals
+ * from each neighbor process
+ * @param[in] mpi_migrant custom MPI datatype for sending migrant_t
+ */
+void send_migrated_out(domain_t *domain, MPI_Request *request,
+                       migrant_t *migrated_out, int send_counts[],
+                       int send_displs[], migrant_t **migrated_in,
+                       size_t *migrated_in_len, size_t *migrated_in_capacity,
+                       int recv_counts[], int recv_displs[],
+                       MPI_Datatype mpi_migrant) {
+  MPI_Neighbor_alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT,
+                        domain->neighbor_comm);
+  size_t total = 0;
+  for (int j = 0; j < domain->num_neighbor_ranks; j++) {
+    recv_displs[j] = total;
+    total += recv_counts[j];
   }
+  DYN_ARRAY_EXTEND(*migrated_in, total, *migrated_in_capacity, migrant_t);
+  *migrated_in_len = total;
+  MPI_Ineighbor_alltoallv(migrated_out, send_counts, send_displs,
+                          mpi_migrant, *migrated_in, recv_counts, recv_displs,
+                          mpi_migrant, domain->neighbor_comm,
+                          request);
 }
 
 /**
- * @brief Calculate the min and max x and y values for a country.
+ * @brief Completes the exchange of the migrated individuals started by \c
+ * send_migrated_out() and inserts them into the local countries
  *
  * @param[in] cfg global configuration
- * @param[in] num_countries total number of countries
- * @param[in] rank rank of this country
- * @return limits_t a struct with the calculated limits
+ * @param[in,out] domain domain of this process
+ * @param[in,out] request request of the exchange
+ * @param[in] migrated_in buffer where the individuals are received
+ * @param[in] migrated_in_len number of individuals received
  */
-limits_t calculate_country_limits(global_config_t *cfg, int num_countries,
-                                  int rank) {
-  /* Determine row and column of this country */
-  int cols = (cfg->world_w / cfg->country_w);
-  int col = rank % cols;
-  int row = rank / cols;
-  /* Build the struct with the values */
-  limits_t limits = {
-      col * cfg->country_w,       /* xmin */
-      (col + 1) * cfg->country_w, /* xmax */
-      row * cfg->country_l,       /* ymin */
-      (row + 1) * cfg->country_l, /* ymax */
-  };
-  return limits;
+void receive_migrated_in(global_config_t *cfg, domain_t *domain,
+                         MPI_Request *request, migrant_t migrated_in[],
+                         size_t migrated_in_len) {
+  MPI_Wait(request, MPI_STATUS_IGNORE);
+  integrate_migrated_in(cfg, domain, migrated_in, migrated_in_len);
 }
 
 /**
- * @brief Calculates the indices of the neighbors of this country
+ * @brief Sends the ghosts in the halo_out buffers to the respective neighbor
+ * processes
  *
- * @param[out] neighbors array where the results will be stored
- * @param[in] cfg global configuration
- * @param[in] num_countries total number of countries
- * @param[in] rank rank of this country
+ * For each neighbor process \c r = <tt>neighbor_ranks[i]</tt> sends the
+ * number \c halo_out_len[r] and then the first \c halo_out_len[r] items of \c
+ * halo_out[r] to \c r .
+ *
+ * Non-blocking sends are performed and the resulting \c MPI_Request are placed
+ * in \c requests[2*i] and \c requests[2*i+1] .
+ *
+ * The sends are performed, and the requests are set even if
+ * <tt>halo_out_len[r] == 0</tt> , since the receiver always expects a message
+ * from each neighbor process.
+ *
+ * @param[in] domain domain of this process
+ * @param[out] requests array of <tt>2 * num_neighbor_ranks</tt> send requests,
+ * that will be filled while sending
+ * @param[in] halo_out array of buffers with ghosts to be sent, indexed by rank
+ * @param[in] halo_out_len lengths of \c halo_out buffers (in number of ghosts)
+ * @param[in] mpi_ghost custom MPI datatype for sending ghost_t
  */
-void calculate_neighbors(int neighbors[], global_config_t *cfg,
-                         int num_countries, int rank) {
-  /* Determine row and column of this country */
-  int cols = (cfg->world_w / cfg->country_w);
-  int rows = (cfg->world_l / cfg->country_l);
-  int col = rank % cols;
-  int row = rank / cols;
-
-  /* Set indices as if this were an internal node */
-  neighbors[SOUTH_EAST] = rank - cols + 1;
-  neighbors[SOUTH] = rank - cols;
-  neighbors[SOUTH_WEST] = rank - cols - 1;
-  neighbors[NORTH_EAST] = rank + cols + 1;
-  neighbors[NORTH] = rank + cols;
-  neighbors[NORTH_WEST] = rank + cols - 1;
-  neighbors[WEST] = rank - 1;
-  neighbors[EAST] = rank + 1;
-
-  /* Correct the indices by considering the world boundaries */
-  if (row == 0) { /* bottom row */
-    neighbors[SOUTH_EAST] = -1;
-    neighbors[SOUTH] = -1;
-    neighbors[SOUTH_WEST] = -1;
-  }
-  if (row == rows - 1) { /* top row */
-    neighbors[NORTH_EAST] = -1;
-    neighbors[NORTH] = -1;
-    neighbors[NORTH_WEST] = -1;
-  }
-
-  if (col == 0) { /* first column */
-    neighbors[SOUTH_WEST] = -1;
-    neighbors[WEST] = -1;
-    neighbors[NORTH_WEST] = -1;
-  }
-  if (col == cols - 1) { /* last column */
-    neighbors[NORTH_EAST] = -1;
-    neighbors[EAST] = -1;
-    neighbors[SOUTH_EAST] = -1;
+void send_halo_out(domain_t *domain, MPI_Request requests[],
+                   ghost_t *halo_out[], size_t halo_out_len[],
+                   MPI_Datatype mpi_ghost) {
+  int r;
+  for (int i = 0; i < domain->num_neighbor_ranks; i++) {
+    r = domain->neighbor_ranks[i];
+    MPI_Isend(&halo_out_len[r], 1, MPI_UNSIGNED_LONG, r, HALO_COUNT_TAG,
+              domain->comm, &requests[2 * i]);
+    MPI_Isend(halo_out[r], halo_out_len[r], mpi_ghost, r, HALO_TAG,
+              domain->comm, &requests[2 * i + 1]);
   }
 }
 
 /**
- * @brief Sends the individuals in the migrated_out buffers to the respective
- * neighbors
- *
- * For each neighbor \c i s.t. <tt>neighbors[i] >= 0</tt> sends the first \c
- * migrated_out_len[i] items of \c migrated_out[i] to \c neighbors[i] .
- *
- * A
- * non-blocking send is performed and the resulting \c MPI_Request is placed in
- * \c requests[i] ;  If <tt>neighbors[i] < 0</tt> \c requests[i] remains
- * unchanged.
- *
- * The send is performed, and the request is set even if
- * <tt>migrated_out_len[i] == 0</tt> to simplify the code that has to check the
- * completion.
- *
- * All arrays in the parameters must have size \c NEIGHBORS_COUNT .
- *
- * @param[out] requests array of send requests, that will be filled while
- * sending
- * @param[in] migrated_out array of buffers with individuals to be migrated,
- * indexed by cardinal direction
- * @param[in] migrated_out_len lengths of \c migrated_out buffers (in number of
- * individuals)
- * @param[in] neighbors array of ranks of neighbors, indexed by cardinal
- * direction
- * @param[in] mpi_individual custom MPI datatype for sending individual_t
+ * @brief Receives the ghosts from all of the neighbor processes and appends
+ * them to the halo of the local countries, in order of arrival
+ *
+ * The receives of the counts must have been posted with \c
+ * post_count_receives() . As soon as the count from a neighbor process \c r
+ * arrives, the receive of its ghosts into \c halo_in[r] is posted, extending
+ * the buffer if necessary; as soon as they arrive, they are integrated with \c
+ * integrate_halo_in() .
+ *
+ * @param[in] cfg global configuration
+ * @param[in,out] domain domain of this process
+ * @param[in,out] requests array of <tt>2 * num_neighbor_ranks</tt> requests,
+ * as set by \c post_count_receives()
+ * @param[out] halo_in array of buffers with received ghosts, indexed by rank
+ * @param[in] halo_in_len number of ghosts sent by each process, indexed by
+ * rank
+ * @param[in,out] halo_in_capacity capacities of the \c halo_in buffers
+ * @param[in] mpi_ghost custom MPI datatype for sending ghost_t
  */
-void send_migrated_out(MPI_Request requests[], individual_t *migrated_out[],
-                       size_t migrated_out_len[], int neighbors[],
-                       MPI_Datatype mpi_individual) {
-  for (int i = 0; i < NEIGHBOR_COUNT; i++) {
-    if (neighbors[i] >= 0) {
-      MPI_Isend(migrated_out[i], migrated_out_len[i], mpi_individual,
-                neighbors[i], MIGRATED_TAG, MPI_COMM_WORLD, &requests[i]);
+void receive_halo_in(global_config_t *cfg, domain_t *domain,
+                     MPI_Request requests[], ghost_t *halo_in[],
+                     size_t halo_in_len[], size_t halo_in_capacity[],
+                     MPI_Datatype mpi_ghost) {
+  const int n = domain->num_neighbor_ranks;
+  int i, r;
+  while (true) {
+    MPI_Waitany(2 * n, requests, &i, MPI_STATUS_IGNORE);
+    if (i == MPI_UNDEFINED) {
+      /* All completed */
+      break;
+    }
+    if (i < n) {
+      /* Count received: post the receive of the ghosts */
+      r = domain->neighbor_ranks[i];
+      DYN_ARRAY_EXTEND(halo_in[r], halo_in_len[r], halo_in_capacity[r],
+                       ghost_t);
+      MPI_Irecv(halo_in[r], halo_in_len[r], mpi_ghost, r, HALO_TAG,
+                domain->comm, &requests[n + i]);
+    } else {
+      /* Ghosts received */
+      r = domain->neighbor_ranks[i - n];
+      integrate_halo_in(cfg, domain, halo_in[r], halo_in_len[r]);
     }
   }
 }
 
 /**
- * @brief Receives the migrated individuals from all of the neighbors and stores
- * them into the migrated_in buffers
- *
- * For each neighbor \c i s.t. <tt>neighbors[i] >= 0</tt> receives all the
- * individuals sent by the corresponding \c send_migrated_out() call and stores
- * them in \c migrated_in[i] , overwriting any previous data. The number of
- * received items is set in \c migrated_in_len[i] .
- *
- * If the \c migrated_in_capacity[i] is not sufficient to hold the new data, the
- * buffer is extended and the value of \c migrated_in_capacity[i] is updated.
- *
- * @param[out] migrated_in array of buffers with received individuals, indexed
- * by cardinal point
- * @param[out] migrated_in_len lengths of \c migrated_in buffers (in number of
- * individuals)
- * @param[in,out] migrated_in_capacity capacities of the \c migrated_in buffers
- * @param[in] neighbors array of ranks of neighbors, indexed by cardinal
- * direction
- * @param[in] mpi_individual custom MPI datatype for sending individual_t
+ * @brief Integrates the individuals received from the neighbor processes into
+ * the population of the local countries
+ *
+ * Each individual is unpacked into the range of the population matching its
+ * status, of the destination country of its record, in order to be able to
+ * reuse the buffer afterwards.
+ *
+ * @param[in] cfg global configuration
+ * @param[in,out] domain domain of this process
+ * @param[in] migrated_in individuals received from the neighbor processes
+ * @param[in] migrated_in_len number of individuals
  */
-void receive_migrated_in(individual_t *migrated_in[], size_t migrated_in_len[],
-                         size_t migrated_in_capacity[], int neighbors[],
-                         MPI_Datatype mpi_individual) {
-  MPI_Status status;
-  int i;
-  for (int j = 0; j < NEIGHBOR_COUNT; j++) {
-    /* Receive in the same order as sending: if NORTH is sent first, then SOUTH
-     * is received first */
-    i = (j + NEIGHBOR_OPPOSITE_DISTANCE) % NEIGHBOR_COUNT;
-    if (neighbors[i] >= 0) {
-      /* Query the number of received individuals */
-      MPI_Probe(neighbors[i], MIGRATED_TAG, MPI_COMM_WORLD, &status);
-      MPI_Get_count(&status, mpi_individual, (int *)&migrated_in_len[i]);
-      /* Extend the buffer if necessary */
-      DYN_ARRAY_EXTEND(migrated_in[i], migrated_in_len[i],
-                       migrated_in_capacity[i], individual_t);
-      /* Store the received items in the buffer */
-      MPI_Recv(migrated_in[i], migrated_in_len[i], mpi_individual, neighbors[i],
-               MIGRATED_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+void integrate_migrated_in(global_config_t *cfg, domain_t *domain,
+                           migrant_t migrated_in[], size_t migrated_in_len) {
+  country_t *country;
+  migrant_t *m;
+  for (size_t j = 0; j < migrated_in_len; j++) {
+    m = &migrated_in[j];
+    if (m->country >= domain->num_countries ||
+        domain->local_index[m->country] < 0) {
+      log_error("Rank %d -- received individual %lu for country %u",
+                domain->rank, m->id, m->country);
+      continue;
     }
+    country = &domain->countries[domain->local_index[m->country]];
+    population_insert_migrant(&country->population, m, &country->limits,
+                              cfg->compact_migration);
   }
 }
 
 /**
- * @brief Integrates the received individuals into the local lists
- *
- * The individuals in \c migrated_in , of any country, are inserted into the
- * local lists according to their status.
- *
- * The received entries are copied from the \c migrated_in buffers onto
- * dynamically allocated entries, in order to be able to reuse the buffers
- * afterwards. If there are entries in \c gc_individuals , these will be used
- * instead of allocating new memory.
- *
- * @param[in] migrated_in array of buffers with received individuals, indexed
- * by cardinal point
- * @param[in] migrated_in_len lengths of \c migrated_in buffers (in number of
- * individuals)
- * @param[in] neighbors array of ranks of neighbors, indexed by cardinal
- * direction
- * @param[in,out] susceptible_individuals list of all susceptible individuals
- * @param[in,out] infected_individuals list of all infected individuals
- * @param[in,out] immune_individuals list of all immune individuals
- * @param[in,out] gc_individuals list of entries to be recycled
+ * @brief Completes the reduction of the last daily summary and hands it over
+ * to the writer on root
+ *
+ * @param[in,out] request request of the reduction, \c MPI_REQUEST_NULL if
+ * there is none pending
+ * @param[in] blocking whether to wait for the reduction, or just test it
+ * @param[in] summary_csv writer of the summary file on root, NULL on the
+ * others
+ * @param[in] summaries summaries of all the days, \p len for each, only
+ * meaningful on root
+ * @param[in] summary_days number of the day of each summary, only meaningful
+ * on root
+ * @param[in] num_summaries number of days, including the last one
+ * @param[in] len number of summaries of each day
  */
-void integrate_migrated_in(individual_t *migrated_in[],
-                           size_t migrated_in_len[], int neighbors[],
-                           individual_list_t *susceptible_individuals,
-                           individual_list_t *infected_individuals,
-                           individual_list_t *immune_individuals,
-                           individual_list_t *gc_individuals) {
-  individual_t *ind;
-  for (int i = 0; i < NEIGHBOR_COUNT; i++) {
-    if (neighbors[i] >= 0) {                            /* for each neighbor */
-      for (size_t j = 0; j < migrated_in_len[i]; j++) { /* for each individ. */
-        /* Get the new list entry */
-        if (INDIVIDUAL_EMPTY(gc_individuals)) {
-          /* Allocate new memory */
-          ind = malloc(sizeof(individual_t));
-        } else {
-          /* Recycle the garbage-collected entry */
-          ind = INDIVIDUAL_FIRST(gc_individuals);
-          INDIVIDUAL_REMOVE_HEAD(gc_individuals);
-        }
-        /* Copy the received data */
-        *ind = migrated_in[i][j];
-        /* Insert into the correct list */
-        switch (ind->status) {
-          case NOT_EXPOSED:
-          case EXPOSED: {
-            INDIVIDUAL_INSERT(susceptible_individuals, ind);
-            break;
-          }
-          case INFECTED: {
-            INDIVIDUAL_INSERT(infected_individuals, ind);
-            break;
-          }
-          case IMMUNE: {
-            INDIVIDUAL_INSERT(immune_individuals, ind);
-            break;
-          }
-        }
-      }
-    }
+void complete_summary(MPI_Request *request, bool blocking,
+                      writer_t *summary_csv, summary_t summaries[],
+                      unsigned long summary_days[], size_t num_summaries,
+                      size_t len) {
+  int done = 1;
+  if (*request == MPI_REQUEST_NULL) {
+    return;
+  }
+  if (blocking) {
+    MPI_Wait(request, MPI_STATUS_IGNORE);
+  } else {
+    MPI_Test(request, &done, MPI_STATUS_IGNORE);
+  }
+  if (done && summary_csv != NULL) {
+    const size_t last = num_summaries - 1;
+    log_info("Writing summary of day %lu", summary_days[last]);
+    summary_csv_write_day(summary_csv, summaries + last * len, len,
+                          summary_days[last]);
+    writer_flush(summary_csv);
   }
 }
 
 /**
- * @brief Waits on MPI requests and returns when all are completed.
+ * @brief Sorts the population of a country if its locality degraded, and
+ * collects the statistics of the sorts
+ *
+ * The population is sorted when it never was, or when the mean distance
+ * between its individuals adjacent in memory grew by \c LOCALITY_DEGRADATION
+ * since its last sort. In the latter case, the sort must also take at most
+ * \c LOCALITY_MAX_OVERHEAD of the time spent on the individuals since the
+ * last one, so that individuals moving fast are not sorted at each check.
+ * The time spent by the exposure and the motion in the
+ * step before and in the one after a sort is recorded, per individual, as a
+ * measure of its effect on the cache.
  *
- * @param[in] requests array of requests, indexed by cardinal direction
- * @param[in] neighbors array of ranks of neighbors, indexed by cardinal
- * direction
+ * @param[in,out] country
+ * @param[in] check whether the locality is checked at this step
+ * @param[in,out] stats statistics of the process
  */
-void wait_all_requests(MPI_Request requests[], int neighbors[]) {
-  for (int i = 0; i < NEIGHBOR_COUNT; i++) {
-    if (neighbors[i] >= 0) {
-      /* TODO: Check status */
-      MPI_Wait(&requests[i], MPI_STATUS_IGNORE);
-    }
+void update_locality(country_t *country, bool check, locality_stats_t *stats) {
+  population_t *pop = &country->population;
+  const size_t moving = pop->immune_begin;
+  /* The step after a sort shows its effect */
+  if (country->sort_step_time >= 0. && moving > 0) {
+    stats->time_before += country->sort_step_time;
+    stats->time_after += country->step_time / moving;
+    stats->timed++;
+  }
+  country->sort_step_time = -1.;
+  country->work_time += country->step_time;
+  if (!check) {
+    return;
+  }
+  const double locality = population_locality(pop);
+  if (country->locality > 0. &&
+      (locality <= LOCALITY_DEGRADATION * country->locality ||
+       country->sort_time > LOCALITY_MAX_OVERHEAD * country->work_time)) {
+    return;
+  }
+  const double start_time = MPI_Wtime();
+  population_sort(pop);
+  const double elapsed = MPI_Wtime() - start_time;
+  country->cost += elapsed;
+  country->sort_time = elapsed;
+  country->work_time = 0.;
+  country->locality = population_locality(pop);
+  if (moving > 0) {
+    country->sort_step_time = country->step_time / moving;
   }
+  stats->sorts++;
+  stats->sort_time += elapsed;
+  stats->locality_before += locality;
+  stats->locality_after += country->locality;
+  log_debug("Country %d: sorted %zu individuals in %.3f ms, locality %.2f m "
+            "-> %.2f m",
+            country->id, moving, elapsed * 1e3, locality, country->locality);
 }
 
 /**
- * @brief Frees the dynamically allocated buffers for migrated individuals
+ * @brief Logs on root the memory used by the populations of all the processes
  *
- * @param migrated array of dynamically allocated buffers, indexed by cardinal
- * point
- * @param neighbors array of indices of neighbors, indexed by cardinal point
+ * Reports the bytes occupied by the individuals and the ones allocated for
+ * the populations, in total and for the process that allocated the most.
+ *
+ * @param[in] domain
  */
-void free_migrated(individual_t *migrated[], int neighbors[]) {
-  for (int i = 0; i < NEIGHBOR_COUNT; i++) {
-    if (neighbors[i] >= 0) {
-      free(migrated[i]);
-    }
+void log_memory_usage(domain_t *domain) {
+  /* NOTE: size_t is an unsigned long */
+  size_t local[2] = {0, 0}, total[2], max[2];
+  for (int k = 0; k < domain->num_local; k++) {
+    population_t *pop = &domain->countries[k].population;
+    const size_t queued =
+        pop->queues[0].len + pop->queues[1].len + pop->exits.len;
+    const size_t queue_capacity = pop->queues[0].capacity +
+                                  pop->queues[1].capacity +
+                                  pop->exits.capacity;
+    local[0] +=
+        pop->len * POPULATION_ITEM_SIZE + queued * sizeof(queue_entry_t);
+    local[1] += pop->capacity * POPULATION_ITEM_SIZE +
+                queue_capacity * sizeof(queue_entry_t);
+  }
+  MPI_Reduce(local, total, 2, MPI_UNSIGNED_LONG, MPI_SUM, ROOT_RANK,
+             domain->comm);
+  MPI_Reduce(local, max, 2, MPI_UNSIGNED_LONG, MPI_MAX, ROOT_RANK,
+             domain->comm);
+  if (domain->rank == ROOT_RANK) {
+    log_info(
+        "Memory of the populations: %.2f MB used of %.2f MB allocated, at most "
+        "%.2f MB used of %.2f MB allocated by a process",
+        total[0] / 1e6, total[1] / 1e6, max[0] / 1e6, max[1] / 1e6);
+  }
+}
+
+/**
+ * @brief Logs on root the statistics of the sorts of all the processes
+ *
+ * Reports the mean locality before and after a sort, and the mean time per
+ * individual spent by the exposure and the motion in the steps around it.
+ *
+ * @param[in] domain
+ * @param[in] stats statistics of the process
+ */
+void log_locality_stats(domain_t *domain, locality_stats_t *stats) {
+  unsigned long local_counts[2] = {stats->sorts, stats->timed}, counts[2];
+  double local_sums[5] = {stats->sort_time, stats->locality_before,
+                          stats->locality_after, stats->time_before,
+                          stats->time_after};
+  double sums[5];
+  MPI_Reduce(local_counts, counts, 2, MPI_UNSIGNED_LONG, MPI_SUM, ROOT_RANK,
+             domain->comm);
+  MPI_Reduce(local_sums, sums, 5, MPI_DOUBLE, MPI_SUM, ROOT_RANK,
+             domain->comm);
+  if (domain->rank != ROOT_RANK) {
+    return;
+  }
+  if (counts[0] == 0) {
+    log_info("Sorted no populations");
+    return;
+  }
+  log_info("Sorted %lu populations in %.3f s: locality from %.2f m to %.2f m",
+           counts[0], sums[0], sums[1] / counts[0], sums[2] / counts[0]);
+  if (counts[1] > 0) {
+    log_info(
+        "Exposure and motion around a sort: %.1f ns per individual before, "
+        "%.1f ns after",
+        sums[3] / counts[1] * 1e9, sums[4] / counts[1] * 1e9);
+  }
+}
+
+/**
+ * @brief Waits on MPI requests and returns when all are completed.
+ *
+ * @param[in] requests array of requests
+ * @param[in] count number of requests
+ */
+void wait_all_requests(MPI_Request requests[], int count) {
+  /* TODO: Check status */
+  MPI_Waitall(count, requests, MPI_STATUSES_IGNORE);
+}
+
+/**
+ * @brief Frees the dynamically allocated buffers for the halo
+ *
+ * @param halo array of buffers, indexed by rank, NULL if not allocated
+ * @param world_size number of processes
+ */
+void free_halo(ghost_t *halo[], int world_size) {
+  for (int r = 0; r < world_size; r++) {
+    free(halo[r]);
   }
 }
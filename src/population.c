@@ -0,0 +1,1036 @@
+#include "population.h"
+
+/**
+ * @brief Returns the group (range) an individual belongs to given its status
+ *
+ * @param[in] status
+ * @return int 0 for susceptible, 1 for infected, 2 for immune
+ */
+static inline int status_group(unsigned char status) {
+  switch (status) {
+    case INFECTED:
+      return 1;
+    case IMMUNE:
+      return 2;
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief Returns the queue where the transitions of the individuals with the
+ * given status are scheduled
+ *
+ * @param[in] pop population
+ * @param[in] status \c INFECTED or \c IMMUNE
+ * @return transition_queue_t* queue of the status
+ */
+static inline transition_queue_t *status_queue(population_t *pop,
+                                               unsigned char status) {
+  return &pop->queues[status_group(status) - 1];
+}
+
+/**
+ * @brief Stores an event at a position of a queue
+ *
+ * @param[in,out] q queue
+ * @param[in,out] pos positions of the individuals in the queue
+ * @param[in] k position in the heap
+ * @param[in] e event
+ */
+static inline void queue_place(transition_queue_t *q, size_t *pos, size_t k,
+                               queue_entry_t e) {
+  q->entries[k] = e;
+  pos[e.index] = k;
+}
+
+/**
+ * @brief Moves the event at a position of a queue towards the root, until its
+ * parent is not due later
+ *
+ * @param[in,out] q queue
+ * @param[in,out] pos positions of the individuals in the queue
+ * @param[in] k position in the heap
+ */
+static void queue_sift_up(transition_queue_t *q, size_t *pos, size_t k) {
+  const queue_entry_t e = q->entries[k];
+  while (k > 0) {
+    size_t parent = (k - 1) / 2;
+    if (q->entries[parent].key <= e.key) {
+      break;
+    }
+    queue_place(q, pos, k, q->entries[parent]);
+    k = parent;
+  }
+  queue_place(q, pos, k, e);
+}
+
+/**
+ * @brief Moves the event at a position of a queue towards the leaves, until
+ * its children are not due earlier
+ *
+ * @param[in,out] q queue
+ * @param[in,out] pos positions of the individuals in the queue
+ * @param[in] k position in the heap
+ */
+static void queue_sift_down(transition_queue_t *q, size_t *pos, size_t k) {
+  const queue_entry_t e = q->entries[k];
+  size_t child;
+  while ((child = 2 * k + 1) < q->len) {
+    if (child + 1 < q->len &&
+        q->entries[child + 1].key < q->entries[child].key) {
+      child++;
+    }
+    if (e.key <= q->entries[child].key) {
+      break;
+    }
+    queue_place(q, pos, k, q->entries[child]);
+    k = child;
+  }
+  queue_place(q, pos, k, e);
+}
+
+/**
+ * @brief Schedules an event of an individual
+ *
+ * @param[in,out] q queue
+ * @param[in,out] pos positions of the individuals in the queue
+ * @param[in] i index of the individual, not scheduled in the queue
+ * @param[in] key time of the event
+ */
+static void queue_push(transition_queue_t *q, size_t *pos, size_t i,
+                       unsigned long key) {
+  if (q->len >= q->capacity) {
+    q->capacity += q->capacity / 2 + DYN_ARRAY_CHUNK;
+    q->entries = realloc(q->entries, q->capacity * sizeof(queue_entry_t));
+  }
+  q->entries[q->len].key = key;
+  q->entries[q->len].index = i;
+  queue_sift_up(q, pos, q->len++);
+}
+
+/**
+ * @brief Cancels the scheduled event of an individual
+ *
+ * @param[in,out] q queue
+ * @param[in,out] pos positions of the individuals in the queue
+ * @param[in] i index of the individual, scheduled in the queue
+ */
+static void queue_remove(transition_queue_t *q, size_t *pos, size_t i) {
+  const size_t k = pos[i];
+  const queue_entry_t last = q->entries[--q->len];
+  pos[i] = POPULATION_UNSCHEDULED;
+  if (k < q->len) {
+    q->entries[k] = last;
+    queue_sift_up(q, pos, k);
+    queue_sift_down(q, pos, pos[last.index]);
+  }
+}
+
+/**
+ * @brief Schedules the transition of an infected or immune individual, when
+ * the time it spent in the status reaches its duration
+ *
+ * @param[in,out] pop population
+ * @param[in] i index of the individual, not scheduled
+ */
+static inline void schedule_transition(population_t *pop, size_t i) {
+  queue_push(status_queue(pop, pop->status[i]), pop->queue_pos, i,
+             pop->t_status[i]);
+}
+
+/**
+ * @brief Cancels the scheduled transition of an individual
+ *
+ * @param[in,out] pop population
+ * @param[in] i index of the individual, scheduled
+ */
+static inline void cancel_transition(population_t *pop, size_t i) {
+  queue_remove(status_queue(pop, pop->status[i]), pop->queue_pos, i);
+}
+
+/* Exits that would happen more steps than this after the time of the motion
+ * are not scheduled, as the individual stops being immune long before */
+#define MAX_EXIT_STEPS 1e15
+
+/**
+ * @brief Folds a coordinate moving on an unbounded line onto an axis of the
+ * world, where the individuals bounce as in \c update_position()
+ *
+ * @param[in] u coordinate on the unbounded line
+ * @param[in] side length of the axis
+ * @param[in,out] d displacement along the line, reversed if the individual is
+ * coming back after bouncing
+ * @return double coordinate inside <tt>[0, side]</tt>
+ */
+static inline double fold(double u, double side, double *d) {
+  double r = fmod(u, 2 * side);
+  if (r < 0) {
+    r += 2 * side;
+  }
+  if (r >= side) {
+    *d = -*d;
+    return 2 * side - r;
+  }
+  return r;
+}
+
+/**
+ * @brief Computes the position and displacement of an immune individual after
+ * some steps from the time of its motion
+ *
+ * @param[in] pop population
+ * @param[in] i index of the immune individual
+ * @param[in] k number of steps
+ * @param[out] m position and displacement, as (x, y, dx, dy)
+ */
+static void motion_after(population_t *pop, size_t i, unsigned long k,
+                         double m[4]) {
+  m[2] = pop->displ_x[i];
+  m[3] = pop->displ_y[i];
+  m[0] = fold(pop->pos_x[i] + k * m[2], pop->motion.world_w, &m[2]);
+  m[1] = fold(pop->pos_y[i] + k * m[3], pop->motion.world_l, &m[3]);
+}
+
+/**
+ * @brief Computes the position and displacement of an immune individual at a
+ * given time, i.e. after the steps before it
+ *
+ * @param[in] pop population
+ * @param[in] i index of the immune individual
+ * @param[in] t time, not earlier than the one of its motion
+ * @param[out] m position and displacement, as (x, y, dx, dy)
+ */
+static void motion_at(population_t *pop, size_t i, unsigned long t,
+                      double m[4]) {
+  motion_after(pop, i, (t - pop->t_motion[i]) / pop->motion.t_step, m);
+}
+
+/**
+ * @brief Stores in the arrays the motion of an immune individual at a given
+ * time, which becomes the time of its motion
+ *
+ * @param[in,out] pop population
+ * @param[in] i index of the immune individual
+ * @param[in] t time, not earlier than the one of its motion
+ */
+static void motion_update(population_t *pop, size_t i, unsigned long t) {
+  double m[4];
+  motion_at(pop, i, t, m);
+  pop->pos_x[i] = m[0];
+  pop->pos_y[i] = m[1];
+  pop->displ_x[i] = m[2];
+  pop->displ_y[i] = m[3];
+  pop->t_motion[i] = t;
+}
+
+/**
+ * @brief Returns the borders of the country crossed by an individual, as
+ * \c update_position() does after moving it
+ *
+ * @param[in] pop population
+ * @param[in] m position and displacement of the individual
+ * @return unsigned char flag of cardinal_point_t , zero if still inside or
+ * bouncing on the border of the world
+ */
+static unsigned char exit_flag(population_t *pop, const double m[4]) {
+  const limits_t *limits = &pop->motion.limits;
+  unsigned char flag = 0;
+  if (m[0] < limits->xmin) {
+    flag |= 1 << WEST;
+  } else if (m[0] >= limits->xmax) {
+    flag |= 1 << EAST;
+  }
+  if (m[1] < limits->ymin) {
+    flag |= 1 << SOUTH;
+  } else if (m[1] >= limits->ymax) {
+    flag |= 1 << NORTH;
+  }
+  return flag & pop->motion.exits;
+}
+
+/**
+ * @brief Returns the borders of the country crossed by an immune individual
+ * after some steps from the time of its motion
+ *
+ * @param[in] pop population
+ * @param[in] i index of the immune individual
+ * @param[in] k number of steps
+ * @return unsigned char flag of cardinal_point_t
+ */
+static unsigned char exit_flag_after(population_t *pop, size_t i,
+                                     unsigned long k) {
+  double m[4];
+  motion_after(pop, i, k, m);
+  return exit_flag(pop, m);
+}
+
+/**
+ * @brief Estimates the steps an individual takes to leave a country along an
+ * axis, bouncing on the border of the world if it is not open
+ *
+ * @param[in] x coordinate
+ * @param[in] d displacement along the axis
+ * @param[in] min lower limit of the country
+ * @param[in] max upper limit of the country
+ * @param[in] side length of the axis of the world
+ * @param[in] open_min whether the lower border leads to a neighbor
+ * @param[in] open_max whether the upper border leads to a neighbor
+ * @return double number of steps, infinite if it never leaves
+ */
+static double axis_exit_steps(double x, double d, double min, double max,
+                              double side, bool open_min, bool open_max) {
+  double distance;
+  if (d > 0 && open_max) {
+    distance = max - x;
+  } else if (d > 0 && open_min) {
+    distance = (side - x) + (side - min);
+  } else if (d < 0 && open_min) {
+    distance = x - min;
+  } else if (d < 0 && open_max) {
+    distance = x + max;
+  } else {
+    return INFINITY;
+  }
+  return distance / fabs(d);
+}
+
+/**
+ * @brief Schedules the time an immune individual leaves the country
+ *
+ * The number of steps is estimated in closed form, then adjusted with the
+ * same computation of the motion that is used when the exit is due, so that
+ * the individual is outside of the country exactly then.
+ *
+ * @param[in,out] pop population
+ * @param[in] i index of the immune individual, not scheduled
+ */
+static void schedule_exit(population_t *pop, size_t i) {
+  const motion_t *motion = &pop->motion;
+  const unsigned char exits = motion->exits;
+  double kx = axis_exit_steps(
+      pop->pos_x[i], pop->displ_x[i], motion->limits.xmin, motion->limits.xmax,
+      motion->world_w, exits & 1 << WEST, exits & 1 << EAST);
+  double ky = axis_exit_steps(
+      pop->pos_y[i], pop->displ_y[i], motion->limits.ymin, motion->limits.ymax,
+      motion->world_l, exits & 1 << SOUTH, exits & 1 << NORTH);
+  double estimate = MIN(kx, ky);
+  if (!(estimate < MAX_EXIT_STEPS)) {
+    return;
+  }
+  unsigned long k = estimate > 1. ? (unsigned long)estimate : 1;
+  while (k > 1 && exit_flag_after(pop, i, k - 1)) {
+    k--;
+  }
+  while (!exit_flag_after(pop, i, k)) {
+    k++;
+  }
+  queue_push(&pop->exits, pop->exit_pos, i,
+             pop->t_motion[i] + k * motion->t_step);
+}
+
+/**
+ * @brief Cancels the scheduled events of an individual
+ *
+ * @param[in,out] pop population
+ * @param[in] i index of the individual
+ */
+static void cancel_events(population_t *pop, size_t i) {
+  if (pop->queue_pos[i] != POPULATION_UNSCHEDULED) {
+    cancel_transition(pop, i);
+  }
+  if (pop->exit_pos[i] != POPULATION_UNSCHEDULED) {
+    queue_remove(&pop->exits, pop->exit_pos, i);
+  }
+}
+
+/**
+ * @brief Schedules the events of an individual according to its status
+ *
+ * @param[in,out] pop population
+ * @param[in] i index of the individual, not scheduled
+ */
+static void schedule_events(population_t *pop, size_t i) {
+  if (status_group(pop->status[i]) > 0) {
+    schedule_transition(pop, i);
+  }
+  if (pop->status[i] == IMMUNE) {
+    schedule_exit(pop, i);
+  }
+}
+
+/**
+ * @brief Updates the index of an individual in its scheduled events, after it
+ * has been moved
+ *
+ * @param[in,out] pop population
+ * @param[in] i new index of the individual
+ */
+static inline void follow_events(population_t *pop, size_t i) {
+  if (pop->queue_pos[i] != POPULATION_UNSCHEDULED) {
+    status_queue(pop, pop->status[i])->entries[pop->queue_pos[i]].index = i;
+  }
+  if (pop->exit_pos[i] != POPULATION_UNSCHEDULED) {
+    pop->exits.entries[pop->exit_pos[i]].index = i;
+  }
+}
+
+/**
+ * @brief Swaps two individuals in all the arrays
+ *
+ * @param[in,out] pop population
+ * @param[in] i index of the first individual
+ * @param[in] j index of the second individual
+ */
+static void population_swap(population_t *pop, size_t i, size_t j) {
+  unsigned long ul;
+  double d;
+  unsigned char uc;
+  size_t z;
+  if (i == j) {
+    return;
+  }
+#define SWAP(arr, tmp) \
+  tmp = arr[i];        \
+  arr[i] = arr[j];     \
+  arr[j] = tmp
+  SWAP(pop->id, ul);
+  SWAP(pop->pos_x, d);
+  SWAP(pop->pos_y, d);
+  SWAP(pop->displ_x, d);
+  SWAP(pop->displ_y, d);
+  SWAP(pop->status, uc);
+  SWAP(pop->t_status, ul);
+  SWAP(pop->t_motion, ul);
+  SWAP(pop->queue_pos, z);
+  SWAP(pop->exit_pos, z);
+  SWAP(pop->verlet, uc);
+#undef SWAP
+  /* Follow the individuals in the queues */
+  follow_events(pop, i);
+  follow_events(pop, j);
+}
+
+/**
+ * @brief Create an empty population
+ *
+ * @return population_t
+ */
+population_t create_population() {
+  population_t pop;
+  pop.id = pop.t_status = pop.t_motion = NULL;
+  pop.pos_x = pop.pos_y = pop.displ_x = pop.displ_y = NULL;
+  pop.status = NULL;
+  pop.queue_pos = pop.exit_pos = NULL;
+  pop.verlet = NULL;
+  for (int q = 0; q < 2; q++) {
+    pop.queues[q].entries = NULL;
+    pop.queues[q].len = pop.queues[q].capacity = 0;
+  }
+  pop.exits.entries = NULL;
+  pop.exits.len = pop.exits.capacity = 0;
+  memset(&pop.motion, 0, sizeof(motion_t));
+  pop.t = 0;
+  pop.joined_infected = 0;
+  pop.infected_begin = pop.immune_begin = pop.len = pop.capacity = 0;
+  return pop;
+}
+
+/**
+ * @brief Frees the dynamically allocated arrays of a population
+ *
+ * @param[in,out] pop population
+ */
+void free_population(population_t *pop) {
+  free(pop->id);
+  free(pop->pos_x);
+  free(pop->pos_y);
+  free(pop->displ_x);
+  free(pop->displ_y);
+  free(pop->status);
+  free(pop->t_status);
+  free(pop->t_motion);
+  free(pop->queue_pos);
+  free(pop->exit_pos);
+  free(pop->verlet);
+  free(pop->queues[0].entries);
+  free(pop->queues[1].entries);
+  free(pop->exits.entries);
+}
+
+/**
+ * @brief Sets the geometry of the country of a population, where its immune
+ * individuals move
+ *
+ * @param[in,out] pop population
+ * @param[in] limits limits of the country
+ * @param[in] neighbors indices of the neighbor countries, indexed by cardinal
+ * point, -1 if none
+ * @param[in] world_w width of the world
+ * @param[in] world_l length of the world
+ * @param[in] t_step duration of a step
+ */
+void population_set_motion(population_t *pop, limits_t *limits,
+                           int neighbors[], double world_w, double world_l,
+                           unsigned long t_step) {
+  const int sides[] = {NORTH, EAST, SOUTH, WEST};
+  pop->motion.limits = *limits;
+  pop->motion.exits = 0;
+  for (int k = 0; k < 4; k++) {
+    if (neighbors[sides[k]] >= 0) {
+      pop->motion.exits |= 1 << sides[k];
+    }
+  }
+  pop->motion.world_w = world_w;
+  pop->motion.world_l = world_l;
+  pop->motion.t_step = t_step;
+}
+
+/**
+ * @brief Reallocates the arrays of a population to the given capacity
+ *
+ * @param[in,out] pop population
+ * @param[in] capacity new capacity, not lower than the length
+ */
+static void population_resize(population_t *pop, size_t capacity) {
+  pop->capacity = capacity;
+  pop->id = realloc(pop->id, capacity * sizeof(unsigned long));
+  pop->pos_x = realloc(pop->pos_x, capacity * sizeof(double));
+  pop->pos_y = realloc(pop->pos_y, capacity * sizeof(double));
+  pop->displ_x = realloc(pop->displ_x, capacity * sizeof(double));
+  pop->displ_y = realloc(pop->displ_y, capacity * sizeof(double));
+  pop->status = realloc(pop->status, capacity * sizeof(unsigned char));
+  pop->t_status = realloc(pop->t_status, capacity * sizeof(unsigned long));
+  pop->t_motion = realloc(pop->t_motion, capacity * sizeof(unsigned long));
+  pop->queue_pos = realloc(pop->queue_pos, capacity * sizeof(size_t));
+  pop->exit_pos = realloc(pop->exit_pos, capacity * sizeof(size_t));
+  pop->verlet = realloc(pop->verlet, capacity * sizeof(unsigned char));
+}
+
+/**
+ * @brief Ensures that the population can hold at least the given number of
+ * individuals without reallocating
+ *
+ * @param[in,out] pop population
+ * @param[in] capacity minimum capacity
+ */
+void population_reserve(population_t *pop, size_t capacity) {
+  if (capacity > pop->capacity) {
+    population_resize(pop, capacity);
+  }
+}
+
+/**
+ * @brief Releases the memory of a population that has shrunk well below its
+ * capacity, e.g. after exporting more individuals than it imported
+ *
+ * The capacity is lowered only when less than half of it is in use, and some
+ * room is left for growing again, so that a population oscillating around the
+ * same size is not reallocated each time.
+ *
+ * @param[in,out] pop population
+ */
+void population_shrink(population_t *pop) {
+  if (pop->capacity > 2 * pop->len + DYN_ARRAY_CHUNK) {
+    population_resize(pop, pop->len + pop->len / 4 + DYN_ARRAY_CHUNK);
+  }
+}
+
+/**
+ * @brief Inserts a copy of an individual into the range matching its status
+ *
+ * The individual is appended and then rotated into its range, with at most two
+ * swaps.
+ *
+ * @param[in,out] pop population
+ * @param[in] ind individual to be copied
+ * @return size_t index of the inserted individual
+ */
+size_t population_insert(population_t *pop, individual_t *ind) {
+  /* Grow geometrically, so that inserting many individuals one at a time
+   * costs a constant amortized time */
+  if (pop->len >= pop->capacity) {
+    population_resize(pop, pop->capacity + pop->capacity / 2 + DYN_ARRAY_CHUNK);
+  }
+  size_t i = pop->len++;
+  pop->id[i] = ind->id;
+  pop->pos_x[i] = ind->pos[0];
+  pop->pos_y[i] = ind->pos[1];
+  pop->displ_x[i] = ind->displ[0];
+  pop->displ_y[i] = ind->displ[1];
+  pop->status[i] = ind->status;
+  pop->t_status[i] = status_group(ind->status) > 0 ? pop->t - ind->t_status
+                                                   : ind->t_status;
+  pop->t_motion[i] = pop->t - ind->t_motion;
+  pop->queue_pos[i] = pop->exit_pos[i] = POPULATION_UNSCHEDULED;
+  /* Nothing is known about its surroundings */
+  pop->verlet[i] = 1;
+  if (ind->status == INFECTED) {
+    pop->joined_infected++;
+  }
+
+  /* Move it to the first position of the immune range, so it becomes the last
+   * infected one */
+  if (status_group(ind->status) < 2) {
+    population_swap(pop, i, pop->immune_begin);
+    i = pop->immune_begin++;
+  }
+  /* Move it to the first position of the infected range, so it becomes the
+   * last susceptible one */
+  if (status_group(ind->status) < 1) {
+    population_swap(pop, i, pop->infected_begin);
+    i = pop->infected_begin++;
+  }
+  schedule_events(pop, i);
+  return i;
+}
+
+/**
+ * @brief Copies an individual out of the population
+ *
+ * @param[in] pop population
+ * @param[in] i index of the individual
+ * @param[out] ind where the individual is copied
+ */
+void population_get(population_t *pop, size_t i, individual_t *ind) {
+  ind->id = pop->id[i];
+  ind->pos[0] = pop->pos_x[i];
+  ind->pos[1] = pop->pos_y[i];
+  ind->displ[0] = pop->displ_x[i];
+  ind->displ[1] = pop->displ_y[i];
+  ind->status = pop->status[i];
+  ind->t_status = population_t_status(pop, i);
+  ind->t_motion = pop->status[i] == IMMUNE ? pop->t - pop->t_motion[i] : 0;
+}
+
+/**
+ * @brief Removes an individual from the population
+ *
+ * The individual is swapped with the last one of its range, and then with the
+ * last one of each following range, until it can be dropped from the end of
+ * the arrays.
+ *
+ * Only individuals at indices greater or equal than \p i are moved, so it is
+ * safe to remove individuals while iterating backwards.
+ *
+ * @param[in,out] pop population
+ * @param[in] i index of the individual
+ */
+void population_remove(population_t *pop, size_t i) {
+  cancel_events(pop, i);
+  if (i < pop->infected_begin) {
+    population_swap(pop, i, --pop->infected_begin);
+    i = pop->infected_begin;
+  }
+  if (i < pop->immune_begin) {
+    population_swap(pop, i, --pop->immune_begin);
+    i = pop->immune_begin;
+  }
+  population_swap(pop, i, --pop->len);
+}
+
+/**
+ * @brief Sets the time of a population whose arrays have been written
+ * directly, and schedules the transitions of its infected and immune
+ * individuals
+ *
+ * @param[in,out] pop population, whose infected and immune individuals record
+ * in \c t_status the time of the first step in the status
+ * @param[in] t time of the next update of the status
+ */
+void population_schedule(population_t *pop, unsigned long t) {
+  pop->t = t;
+  pop->queues[0].len = pop->queues[1].len = pop->exits.len = 0;
+  for (size_t i = 0; i < pop->len; i++) {
+    pop->queue_pos[i] = pop->exit_pos[i] = POPULATION_UNSCHEDULED;
+    pop->verlet[i] = 1;
+  }
+  for (size_t i = pop->infected_begin; i < pop->len; i++) {
+    schedule_events(pop, i);
+  }
+}
+
+/**
+ * @brief Advances the time of a population by a step, performing the due
+ * transitions and moving the individuals into the range of their new status
+ *
+ * Only the immune and infected individuals whose transition is due are
+ * visited, popping them from the queues: the cost does not depend on the size
+ * of the ranges. They become due when the time spent in the status at the end
+ * of the step reaches its duration, as in \c next_status() . Each individual
+ * changes status at most once, as the ones entering a status are scheduled
+ * after its queue has been processed.
+ *
+ * The individuals becoming immune stop moving, while the ones leaving the
+ * status get the motion they would have had by moving at each step.
+ *
+ * @pre The susceptible individuals that got infected in this step have
+ * already been set to \c INFECTED , in place
+ *
+ * @param[in,out] pop population
+ * @param[in] t_step duration of the step
+ * @param[in] t_recovery duration of the infection
+ * @param[in] t_immunity duration of the immunity
+ */
+void population_advance(population_t *pop, unsigned long t_step,
+                        unsigned long t_recovery, unsigned long t_immunity) {
+  transition_queue_t *infected = &pop->queues[0], *immune = &pop->queues[1];
+  size_t i;
+  pop->t += t_step;
+
+  /* Immune to susceptible: moved across the infected range */
+  while (immune->len > 0 && immune->entries[0].key + t_immunity <= pop->t) {
+    i = immune->entries[0].index;
+    cancel_events(pop, i);
+    motion_update(pop, i, pop->t);
+    pop->status[i] = NOT_EXPOSED;
+    pop->t_status[i] = 0;
+    pop->verlet[i] = 1;
+    population_swap(pop, i, pop->immune_begin);
+    i = pop->immune_begin++;
+    population_swap(pop, i, pop->infected_begin++);
+  }
+
+  /* Infected to immune */
+  while (infected->len > 0 &&
+         infected->entries[0].key + t_recovery <= pop->t) {
+    i = infected->entries[0].index;
+    cancel_events(pop, i);
+    pop->status[i] = IMMUNE;
+    pop->t_status[i] = pop->t_motion[i] = pop->t;
+    population_swap(pop, i, --pop->immune_begin);
+    schedule_events(pop, pop->immune_begin);
+  }
+
+  /* Susceptible to infected, iterating backwards so that the individuals
+   * swapped in from the end of the range have already been visited */
+  for (i = pop->infected_begin; i-- > 0;) {
+    if (pop->status[i] == INFECTED) {
+      pop->t_status[i] = pop->t;
+      pop->joined_infected++;
+      population_swap(pop, i, --pop->infected_begin);
+      schedule_events(pop, pop->infected_begin);
+    }
+  }
+}
+
+/**
+ * @brief Returns the time an individual has passed in its status, or has
+ * been exposed if susceptible
+ *
+ * @param[in] pop population
+ * @param[in] i index of the individual
+ * @return unsigned long time passed in the status
+ */
+unsigned long population_t_status(population_t *pop, size_t i) {
+  return status_group(pop->status[i]) > 0 ? pop->t - pop->t_status[i]
+                                          : pop->t_status[i];
+}
+
+/**
+ * @brief Returns the current position and displacement of an individual
+ *
+ * @param[in] pop population
+ * @param[in] i index of the individual
+ * @param[out] motion position and displacement, as (x, y, dx, dy)
+ */
+void population_get_motion(population_t *pop, size_t i, double motion[4]) {
+  if (pop->status[i] == IMMUNE) {
+    motion_at(pop, i, pop->t, motion);
+    return;
+  }
+  motion[0] = pop->pos_x[i];
+  motion[1] = pop->pos_y[i];
+  motion[2] = pop->displ_x[i];
+  motion[3] = pop->displ_y[i];
+}
+
+/**
+ * @brief Pops an immune individual that leaves the country while moving in
+ * the current step, if any
+ *
+ * Its position and displacement after the step are stored in the arrays, so
+ * that it can be copied out as a migrant and removed.
+ *
+ * @param[in,out] pop population
+ * @param[out] i index of the individual
+ * @param[out] dest cardinal point of the destination country
+ * @return true if an individual leaves the country
+ */
+bool population_pop_exit(population_t *pop, size_t *i, int *dest) {
+  const unsigned long t = pop->t + pop->motion.t_step;
+  double m[4];
+  if (pop->exits.len == 0 || pop->exits.entries[0].key > t) {
+    return false;
+  }
+  *i = pop->exits.entries[0].index;
+  queue_remove(&pop->exits, pop->exit_pos, *i);
+  motion_at(pop, *i, t, m);
+  *dest = decode_cardinal_point_flag(exit_flag(pop, m));
+  motion_update(pop, *i, t);
+  return true;
+}
+
+/**
+ * @brief Converts a coordinate to single precision, relative to the lower
+ * bound of a range
+ *
+ * @param[in] x coordinate, expected inside the range
+ * @param[in] min inclusive lower bound of the range
+ * @param[in] max exclusive upper bound of the range
+ * @return float relative coordinate, inside <tt>[0, max - min)</tt> even
+ * after rounding
+ */
+static float to_relative(double x, unsigned long min, unsigned long max) {
+  const float side = (float)(max - min);
+  float rel = (float)(x - min);
+  if (rel < 0.f) {
+    rel = 0.f;
+  } else if (rel >= side) {
+    rel = nextafterf(side, 0.f);
+  }
+  return rel;
+}
+
+/**
+ * @brief Converts a relative coordinate back to an absolute one
+ *
+ * @param[in] rel coordinate relative to \p min
+ * @param[in] min inclusive lower bound of the range
+ * @param[in] max exclusive upper bound of the range
+ * @return double absolute coordinate, inside <tt>[min, max)</tt> even after
+ * rounding
+ */
+static double from_relative(float rel, unsigned long min, unsigned long max) {
+  double x = min + (double)rel;
+  return x < max ? x : nextafter((double)max, 0.);
+}
+
+/**
+ * @brief Copies an individual out of the population as a migrant record
+ *
+ * @param[in] pop population
+ * @param[in] i index of the individual
+ * @param[in] country index of the destination country
+ * @param[in] limits limits of the destination country, only used by the
+ * compact format
+ * @param[in] compact whether to use the compact format
+ * @param[out] m where the record is written
+ */
+void population_get_migrant(population_t *pop, size_t i, int country,
+                            limits_t *limits, bool compact, migrant_t *m) {
+  m->id = pop->id[i];
+  m->country = country;
+  m->status_timer =
+      MIGRANT_PACK_STATUS(pop->status[i], population_t_status(pop, i));
+  if (compact) {
+    m->motion.compact[0] =
+        to_relative(pop->pos_x[i], limits->xmin, limits->xmax);
+    m->motion.compact[1] =
+        to_relative(pop->pos_y[i], limits->ymin, limits->ymax);
+    m->motion.compact[2] = (float)pop->displ_x[i];
+    m->motion.compact[3] = (float)pop->displ_y[i];
+  } else {
+    m->motion.full[0] = pop->pos_x[i];
+    m->motion.full[1] = pop->pos_y[i];
+    m->motion.full[2] = pop->displ_x[i];
+    m->motion.full[3] = pop->displ_y[i];
+  }
+}
+
+/**
+ * @brief Inserts the individual of a migrant record into the range matching
+ * its status
+ *
+ * @param[in,out] pop population of the destination country
+ * @param[in] m record of the individual
+ * @param[in] limits limits of the destination country, only used by the
+ * compact format
+ * @param[in] compact whether the record uses the compact format
+ * @return size_t index of the inserted individual
+ */
+size_t population_insert_migrant(population_t *pop, migrant_t *m,
+                                 limits_t *limits, bool compact) {
+  individual_t ind;
+  ind.id = m->id;
+  ind.status = MIGRANT_STATUS(m);
+  ind.t_status = MIGRANT_T_STATUS(m);
+  ind.t_motion = 0;
+  if (compact) {
+    ind.pos[0] =
+        from_relative(m->motion.compact[0], limits->xmin, limits->xmax);
+    ind.pos[1] =
+        from_relative(m->motion.compact[1], limits->ymin, limits->ymax);
+    ind.displ[0] = m->motion.compact[2];
+    ind.displ[1] = m->motion.compact[3];
+  } else {
+    ind.pos[0] = m->motion.full[0];
+    ind.pos[1] = m->motion.full[1];
+    ind.displ[0] = m->motion.full[2];
+    ind.displ[1] = m->motion.full[3];
+  }
+  return population_insert(pop, &ind);
+}
+
+/**
+ * @brief Maps a point of a square grid to its distance along a Hilbert curve
+ *
+ * @param[in] x column of the point, in <tt>[0, 2^POPULATION_CURVE_ORDER)</tt>
+ * @param[in] y row of the point, in <tt>[0, 2^POPULATION_CURVE_ORDER)</tt>
+ * @return uint32_t distance of the point from the start of the curve
+ */
+static uint32_t hilbert_key(uint32_t x, uint32_t y) {
+  const uint32_t n = 1u << POPULATION_CURVE_ORDER;
+  uint32_t key = 0;
+  for (uint32_t s = n / 2; s > 0; s /= 2) {
+    uint32_t rx = (x & s) > 0;
+    uint32_t ry = (y & s) > 0;
+    key += s * s * ((3 * rx) ^ ry);
+    /* Rotate the quadrant, so that the sub-curve is traversed in order */
+    if (ry == 0) {
+      if (rx == 1) {
+        x = n - 1 - x;
+        y = n - 1 - y;
+      }
+      uint32_t tmp = x;
+      x = y;
+      y = tmp;
+    }
+  }
+  return key;
+}
+
+/**
+ * @brief Maps a coordinate to a cell of the grid of the Hilbert curve
+ *
+ * @param[in] value coordinate
+ * @param[in] min lower limit of the coordinate
+ * @param[in] max upper limit of the coordinate
+ * @return uint32_t cell, clamped to the grid
+ */
+static uint32_t curve_cell(double value, unsigned long min,
+                           unsigned long max) {
+  const uint32_t cells = 1u << POPULATION_CURVE_ORDER;
+  double rel = (value - min) / (max - min) * cells;
+  return rel <= 0. ? 0 : rel >= cells ? cells - 1 : (uint32_t)rel;
+}
+
+/**
+ * @brief Individual of a range being sorted, with its key on the curve
+ */
+typedef struct curve_entry {
+  uint32_t key; /**< Distance along the Hilbert curve */
+  size_t index; /**< Index of the individual before sorting */
+} curve_entry_t;
+
+/**
+ * @brief Compares two entries by key, then by index so that the order is
+ * deterministic
+ *
+ * @param[in] a first curve_entry_t
+ * @param[in] b second curve_entry_t
+ * @return int negative, zero or positive as in \c qsort()
+ */
+static int compare_curve_entries(const void *a, const void *b) {
+  const curve_entry_t *ea = a, *eb = b;
+  if (ea->key != eb->key) {
+    return ea->key < eb->key ? -1 : 1;
+  }
+  return ea->index < eb->index ? -1 : ea->index > eb->index;
+}
+
+/**
+ * @brief Sorts a range of individuals along a Hilbert curve
+ *
+ * @param[in,out] pop population
+ * @param[in] begin first index of the range
+ * @param[in] end index past the end of the range
+ * @param[in] order buffer for the entries of the range
+ * @param[in] tmp buffer for a column of the range, as large as its widest
+ * element
+ */
+static void sort_range(population_t *pop, size_t begin, size_t end,
+                       curve_entry_t *order, void *tmp) {
+  const limits_t *limits = &pop->motion.limits;
+  const size_t n = end - begin;
+  if (n < 2) {
+    return;
+  }
+  for (size_t k = 0; k < n; k++) {
+    order[k].key =
+        hilbert_key(curve_cell(pop->pos_x[begin + k], limits->xmin,
+                               limits->xmax),
+                    curve_cell(pop->pos_y[begin + k], limits->ymin,
+                               limits->ymax));
+    order[k].index = begin + k;
+  }
+  qsort(order, n, sizeof(curve_entry_t), compare_curve_entries);
+#define PERMUTE(arr, type)                  \
+  for (size_t k = 0; k < n; k++) {          \
+    ((type *)tmp)[k] = arr[order[k].index]; \
+  }                                         \
+  memcpy(arr + begin, tmp, n * sizeof(type))
+  PERMUTE(pop->id, unsigned long);
+  PERMUTE(pop->pos_x, double);
+  PERMUTE(pop->pos_y, double);
+  PERMUTE(pop->displ_x, double);
+  PERMUTE(pop->displ_y, double);
+  PERMUTE(pop->status, unsigned char);
+  PERMUTE(pop->t_status, unsigned long);
+  PERMUTE(pop->t_motion, unsigned long);
+  PERMUTE(pop->queue_pos, size_t);
+  PERMUTE(pop->exit_pos, size_t);
+  PERMUTE(pop->verlet, unsigned char);
+#undef PERMUTE
+  /* Follow the individuals in the queues */
+  for (size_t i = begin; i < end; i++) {
+    follow_events(pop, i);
+  }
+}
+
+/**
+ * @brief Sorts the susceptible and the infected individuals along a Hilbert
+ * curve over the country, so that the ones close in space are close in memory
+ *
+ * Each range is sorted on its own, and the immune individuals are not sorted,
+ * since they are not visited at each step and their positions are stale.
+ *
+ * @param[in,out] pop population
+ */
+void population_sort(population_t *pop) {
+  const size_t n = pop->immune_begin;
+  if (n < 2) {
+    return;
+  }
+  curve_entry_t *order = malloc(n * sizeof(curve_entry_t));
+  void *tmp = malloc(n * MAX(sizeof(double), sizeof(size_t)));
+  sort_range(pop, 0, pop->infected_begin, order, tmp);
+  sort_range(pop, pop->infected_begin, pop->immune_begin, order, tmp);
+  free(order);
+  free(tmp);
+}
+
+/**
+ * @brief Measures how far apart in space are the individuals that are
+ * adjacent in memory
+ *
+ * The lower the value, the fewer cache lines are touched by the searches of
+ * the exposure, whose neighbors are close in space.
+ *
+ * @param[in] pop population
+ * @return double mean distance between consecutive susceptible, and between
+ * consecutive infected individuals, 0 if there are none
+ */
+double population_locality(population_t *pop) {
+  double sum = 0.;
+  size_t pairs = 0;
+  for (size_t i = 1; i < pop->immune_begin; i++) {
+    if (i == pop->infected_begin) {
+      continue;
+    }
+    sum += hypot(pop->pos_x[i] - pop->pos_x[i - 1],
+                 pop->pos_y[i] - pop->pos_y[i - 1]);
+    pairs++;
+  }
+  return pairs > 0 ? sum / pairs : 0.;
+}
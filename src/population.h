@@ -0,0 +1,158 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "individual.h"
+#include "utils.h"
+#include "world.h"
+
+/* Position in the queues of an individual that is not scheduled */
+#define POPULATION_UNSCHEDULED SIZE_MAX
+
+/**
+ * @brief Event of an individual scheduled in a queue
+ */
+typedef struct queue_entry {
+  unsigned long key; /**< Time of the event */
+  size_t index;      /**< Index of the individual in the population */
+} queue_entry_t;
+
+/**
+ * @brief Pending events of some individuals, as a binary min-heap ordered by
+ * their time
+ */
+typedef struct transition_queue {
+  queue_entry_t *entries; /**< Scheduled events */
+  size_t len;             /**< Number of scheduled individuals */
+  size_t capacity;        /**< Capacity of the heap */
+} transition_queue_t;
+
+/**
+ * @brief Geometry of a country, used to compute the motion of its immune
+ * individuals without moving them at each step
+ */
+typedef struct motion {
+  limits_t limits;         /**< Limits of the country */
+  unsigned char exits;     /**< Borders shared with a neighbor country, as a
+                              flag of cardinal_point_t */
+  double world_w, world_l; /**< Size of the world, where individuals bounce */
+  unsigned long t_step;    /**< Duration of a step */
+} motion_t;
+
+/**
+ * @brief Population of a country, stored as a structure of arrays
+ *
+ * Each individual occupies the same index in all the arrays. The individuals
+ * are grouped by status into three contiguous ranges:
+ *  - susceptible (\c NOT_EXPOSED or \c EXPOSED ) in <tt>[0,
+ * infected_begin)</tt>
+ *  - \c INFECTED in <tt>[infected_begin, immune_begin)</tt>
+ *  - \c IMMUNE in <tt>[immune_begin, len)</tt>
+ *
+ * The order of the individuals inside a range is not significant, and it
+ * changes whenever individuals are inserted, removed or change status.
+ *
+ * The susceptible individuals count the time they have been exposed in \c
+ * t_status , while the infected and immune ones record there the time of the
+ * first step they spent in the status, so that they are not visited at each
+ * step: their transitions are scheduled in two queues ordered by \c t_status ,
+ * and only the due ones are popped by \c population_advance() . Individuals
+ * enter and leave the population with the time passed in the status, as in
+ * individual_t .
+ *
+ * The immune individuals are not moved at each step either, since they take
+ * no part in the exposure: their position and displacement are the ones at
+ * time \c t_motion , from which the current ones are computed in closed form
+ * when needed. The time they leave the country is scheduled in a third queue,
+ * popped by \c population_pop_exit() .
+ *
+ * The susceptible individuals also carry the Verlet flag kept by
+ * \c update_exposure() , which becomes stale when other individuals join the
+ * infected range: they are counted in \c joined_infected .
+ */
+typedef struct population {
+  unsigned long *id;         /**< Unique id of each individual in the world */
+  double *pos_x, *pos_y;     /**< (x,y) position */
+  double *displ_x, *displ_y; /**< (dx, dy) displacement applied at each step */
+  unsigned char *status;     /**< Status, as in individual_status_t */
+  unsigned long *t_status;   /**< Exposure time, or time of the first step in
+                                the status if infected or immune */
+  unsigned long *t_motion;   /**< Time of the motion, if immune */
+  size_t *queue_pos;         /**< Position in the queue of its status, or
+                                POPULATION_UNSCHEDULED */
+  size_t *exit_pos;          /**< Position in the queue of the exits, or
+                                POPULATION_UNSCHEDULED */
+  unsigned char *verlet;     /**< Whether a susceptible individual had
+                                infected ones within the Verlet radius when
+                                the flags were last computed */
+  /** Scheduled transitions of the infected and of the immune individuals */
+  transition_queue_t queues[2];
+  transition_queue_t exits; /**< Scheduled exits of the immune individuals */
+  motion_t motion;          /**< Geometry of the country */
+  unsigned long t;          /**< Time of the next update of the status */
+  size_t joined_infected;   /**< Individuals that got infected or were
+                               inserted as infected since the Verlet flags
+                               were last computed */
+  size_t infected_begin;    /**< Index of the first infected individual */
+  size_t immune_begin;      /**< Index of the first immune individual */
+  size_t len;               /**< Number of individuals */
+  size_t capacity;          /**< Capacity of the arrays */
+} population_t;
+
+#define POPULATION_SUSCEPTIBLE_COUNT(p) ((p)->infected_begin)
+
+#define POPULATION_INFECTED_COUNT(p) ((p)->immune_begin - (p)->infected_begin)
+
+#define POPULATION_IMMUNE_COUNT(p) ((p)->len - (p)->immune_begin)
+
+/* Bits per axis of the grid of the Hilbert curve used by population_sort() */
+#define POPULATION_CURVE_ORDER 16
+
+/* Size in bytes of an individual in the arrays of a population, one item of
+ * each column of population_t */
+#define POPULATION_ITEM_SIZE                                             \
+  (3 * sizeof(unsigned long) + 4 * sizeof(double) + 2 * sizeof(size_t) + \
+   2 * sizeof(unsigned char))
+
+population_t create_population();
+
+void population_set_motion(population_t *pop, limits_t *limits,
+                           int neighbors[], double world_w, double world_l,
+                           unsigned long t_step);
+
+void free_population(population_t *pop);
+
+void population_reserve(population_t *pop, size_t capacity);
+
+void population_shrink(population_t *pop);
+
+size_t population_insert(population_t *pop, individual_t *ind);
+
+void population_get(population_t *pop, size_t i, individual_t *ind);
+
+void population_remove(population_t *pop, size_t i);
+
+void population_schedule(population_t *pop, unsigned long t);
+
+void population_advance(population_t *pop, unsigned long t_step,
+                        unsigned long t_recovery, unsigned long t_immunity);
+
+unsigned long population_t_status(population_t *pop, size_t i);
+
+void population_get_motion(population_t *pop, size_t i, double motion[4]);
+
+bool population_pop_exit(population_t *pop, size_t *i, int *dest);
+
+void population_get_migrant(population_t *pop, size_t i, int country,
+                            limits_t *limits, bool compact, migrant_t *m);
+
+size_t population_insert_migrant(population_t *pop, migrant_t *m,
+                                 limits_t *limits, bool compact);
+
+void population_sort(population_t *pop);
+
+double population_locality(population_t *pop);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Counter-based random number generator Philox4x32-10 (Salmon et al., 2011).
+ *
+ * Each output is a pure function of a counter and a key, so there is no state
+ * to share between threads, and the numbers of an individual depend only on
+ * the seed and on its id, not on which process or thread generates them.
+ */
+
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+#define PHILOX_ROUNDS 10
+
+/**
+ * @brief Computes the Philox4x32-10 block of a counter
+ *
+ * @param[in,out] ctr counter, replaced by the random block
+ * @param[in] key
+ */
+static inline void philox4x32(uint32_t ctr[4], const uint32_t key[2]) {
+  uint32_t k0 = key[0], k1 = key[1];
+  for (int r = 0; r < PHILOX_ROUNDS; r++) {
+    const uint64_t p0 = (uint64_t)PHILOX_M0 * ctr[0];
+    const uint64_t p1 = (uint64_t)PHILOX_M1 * ctr[2];
+    const uint32_t c1 = ctr[1], c3 = ctr[3];
+    ctr[0] = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    ctr[1] = (uint32_t)p1;
+    ctr[2] = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    ctr[3] = (uint32_t)p0;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+}
+
+/**
+ * @brief Generates two uniform numbers in [0, 1) for an individual
+ *
+ * @param[in] seed
+ * @param[in] id id of the individual
+ * @param[in] n index of the pair, to draw more than two numbers for the same
+ * individual
+ * @param[out] u pair of numbers, with 53 random bits each
+ */
+static inline void rng_uniform2(uint32_t seed, uint64_t id, uint32_t n,
+                                double u[2]) {
+  uint32_t ctr[4] = {(uint32_t)id, (uint32_t)(id >> 32), n, 0};
+  const uint32_t key[2] = {seed, 0};
+  philox4x32(ctr, key);
+  u[0] = ((((uint64_t)ctr[0] << 32) | ctr[1]) >> 11) * 0x1p-53;
+  u[1] = ((((uint64_t)ctr[2] << 32) | ctr[3]) >> 11) * 0x1p-53;
+}
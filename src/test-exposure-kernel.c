@@ -0,0 +1,110 @@
+/*
+ * Checks that every implementation of any_within supported by the running CPU
+ * finds exactly the same positions as the scalar one, on blocks of every
+ * length up to TEST_MAX_LEN and with positions exactly at the distance.
+ *
+ * Usage: ./test-exposure-kernel
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "exposure-kernel.h"
+
+/* Longest block of positions, covering the tails of all the kernels */
+#define TEST_MAX_LEN 64
+
+/* Random blocks checked for each length */
+#define TEST_RANDOM_BLOCKS 2000
+
+/**
+ * @brief Returns a random number in [min, max)
+ */
+static double random_in(double min, double max) {
+  return min + (max - min) * drand48();
+}
+
+/**
+ * @brief Compares a kernel with the scalar implementation on a block
+ *
+ * @return int 1 if they disagree, 0 otherwise
+ */
+static int check_block(const char *name, any_within_fn_t kernel,
+                       const double *pos_x, const double *pos_y, size_t len,
+                       double x, double y, double distance_sq) {
+  bool expected = any_within_scalar(pos_x, pos_y, len, x, y, distance_sq);
+  bool found = kernel(pos_x, pos_y, len, x, y, distance_sq);
+  if (found != expected) {
+    fprintf(stderr,
+            "%s: found %d instead of %d with %zu positions around (%.17g, "
+            "%.17g), squared distance %.17g\n",
+            name, found, expected, len, x, y, distance_sq);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Checks a kernel on random blocks, and on blocks with a single
+ * position at each index, exactly at the distance or just beyond it
+ *
+ * @return int number of failed checks
+ */
+static int check_kernel(const char *name, any_within_fn_t kernel) {
+  double pos_x[TEST_MAX_LEN], pos_y[TEST_MAX_LEN];
+  int failures = 0;
+  srand48(42);
+  for (size_t len = 0; len <= TEST_MAX_LEN; len++) {
+    /* Random blocks, about half of them with a position within the distance */
+    for (int b = 0; b < TEST_RANDOM_BLOCKS; b++) {
+      const double x = random_in(0., 1000.), y = random_in(0., 1000.);
+      const double spread = random_in(10., 100.);
+      for (size_t k = 0; k < len; k++) {
+        pos_x[k] = x + random_in(-spread, spread);
+        pos_y[k] = y + random_in(-spread, spread);
+      }
+      const double distance = spread / (len > 0 ? sqrt(len) : 1.);
+      failures += check_block(name, kernel, pos_x, pos_y, len, x, y,
+                              distance * distance);
+    }
+    /* A single position at each index, far from the others: at the distance
+     * it is found, just inside the squared distance it is not */
+    for (size_t hit = 0; hit < len; hit++) {
+      const double x = random_in(0., 1000.), y = random_in(0., 1000.);
+      for (size_t k = 0; k < len; k++) {
+        pos_x[k] = x + 1e4;
+        pos_y[k] = y - 1e4;
+      }
+      pos_x[hit] = x + random_in(-20., 20.);
+      pos_y[hit] = y + random_in(-20., 20.);
+      const double dx = pos_x[hit] - x, dy = pos_y[hit] - y;
+      const double distance_sq = dx * dx + dy * dy;
+      failures += check_block(name, kernel, pos_x, pos_y, len, x, y,
+                              distance_sq);
+      failures += check_block(name, kernel, pos_x, pos_y, len, x, y,
+                              nextafter(distance_sq, 0.));
+      if (!kernel(pos_x, pos_y, len, x, y, distance_sq)) {
+        fprintf(stderr, "%s: missed the position at the distance\n", name);
+        failures++;
+      }
+    }
+  }
+  return failures;
+}
+
+int main() {
+  static const char *names[] = {"scalar", "avx2", "avx512"};
+  int failures = 0;
+  for (size_t k = 0; k < sizeof(names) / sizeof(names[0]); k++) {
+    any_within_fn_t kernel = find_exposure_kernel(names[k]);
+    if (kernel == NULL) {
+      printf("%s: not supported, skipped\n", names[k]);
+      continue;
+    }
+    int kernel_failures = check_kernel(names[k], kernel);
+    printf("%s: %s\n", names[k], kernel_failures == 0 ? "ok" : "FAILED");
+    failures += kernel_failures;
+  }
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,393 @@
+#include "trace.h"
+
+/**
+ * @brief Writes raw data to a trace, advancing its offset
+ *
+ * If the trace is shared, the data is appended to the buffer of the step,
+ * otherwise to the current buffer of the writer.
+ *
+ * @param[in,out] trace
+ * @param[in] data
+ * @param[in] size number of bytes
+ */
+static void trace_write(trace_t *trace, const void *data, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  if (trace->shared) {
+    const int k = trace->current;
+    size_t target_len = trace->offset + size;
+    DYN_ARRAY_EXTEND(trace->buffers[k], target_len, trace->buffer_capacity[k],
+                     char);
+    memcpy(trace->buffers[k] + trace->offset, data, size);
+  } else {
+    writer_append(trace->writer, data, size);
+  }
+  trace->offset += size;
+}
+
+/**
+ * @brief Fills the header of a trace with the configuration
+ *
+ * @param[out] header
+ * @param[in] rank rank of the writer, -1 if shared
+ * @param[in] cfg global configuration
+ */
+static void fill_trace_header(trace_header_t *header, int rank,
+                              global_config_t *cfg) {
+  memset(header, 0, sizeof(trace_header_t));
+  memcpy(header->magic, TRACE_MAGIC, sizeof(header->magic));
+  header->version = TRACE_VERSION;
+  header->rank = rank;
+  header->num_individuals = cfg->num_individuals;
+  header->inf_individuals = cfg->inf_individuals;
+  header->world_w = cfg->world_w;
+  header->world_l = cfg->world_l;
+  header->country_w = cfg->country_w;
+  header->country_l = cfg->country_l;
+  header->velocity = cfg->velocity;
+  header->spreading_distance = cfg->spreading_distance;
+  header->t_infection = cfg->t_infection;
+  header->t_recovery = cfg->t_recovery;
+  header->t_immunity = cfg->t_immunity;
+  header->t_step = cfg->t_step;
+  header->t_target = cfg->t_target;
+  header->rand_seed = cfg->rand_seed;
+  header->trace_every = cfg->trace_every;
+  header->trace_sample_rate = cfg->trace_sample_rate;
+  memcpy(header->trace_region, cfg->trace_region, sizeof(cfg->trace_region));
+}
+
+/**
+ * @brief Mixes the bits of an id, so that any fraction of the range of the
+ * hashes is a uniform sample of the ids (SplitMix64 finalizer)
+ *
+ * @param[in] id
+ * @param[in] seed
+ * @return uint64_t
+ */
+static uint64_t hash_id(uint64_t id, uint64_t seed) {
+  uint64_t z = id + seed + 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @brief Writes a column of a block, made of the items of the traced
+ * individuals only
+ *
+ * @param[in,out] trace
+ * @param[in] column column of the population
+ * @param[in] item_size size in bytes of an item of the column
+ * @param[in] len number of traced individuals, in \c trace->selected
+ */
+static void trace_write_selected(trace_t *trace, const void *column,
+                                 size_t item_size, size_t len) {
+  const char *src = column;
+  size_t target_len = len * item_size;
+  DYN_ARRAY_EXTEND(trace->column, target_len, trace->column_capacity, char);
+  for (size_t i = 0; i < len; i++) {
+    memcpy(trace->column + i * item_size,
+           src + trace->selected[i] * item_size, item_size);
+  }
+  trace_write(trace, trace->column, target_len);
+}
+
+/**
+ * @brief Writes the time passed by each traced individual in its status
+ *
+ * It is gathered from the population, where the infected and immune
+ * individuals record the time they entered the status instead.
+ *
+ * @param[in,out] trace trace, not NULL
+ * @param[in] population population being written
+ * @param[in] len number of traced individuals
+ */
+static void trace_write_t_status(trace_t *trace, population_t *population,
+                                 size_t len) {
+  size_t target_len = len * sizeof(unsigned long);
+  DYN_ARRAY_EXTEND(trace->column, target_len, trace->column_capacity, char);
+  unsigned long *dst = (unsigned long *)trace->column;
+  for (size_t i = 0; i < len; i++) {
+    dst[i] = population_t_status(population,
+                                 trace->filtered ? trace->selected[i] : i);
+  }
+  trace_write(trace, trace->column, target_len);
+}
+
+/**
+ * @brief Writes the position and displacement of each traced individual
+ *
+ * They are gathered from the population, where the immune individuals record
+ * the ones at an earlier time instead.
+ *
+ * @param[in,out] trace trace, not NULL
+ * @param[in] population population being written
+ * @param[in] len number of traced individuals
+ */
+static void trace_write_motion(trace_t *trace, population_t *population,
+                               size_t len) {
+  size_t target_len = 4 * len * sizeof(double);
+  double motion[4];
+  DYN_ARRAY_EXTEND(trace->column, target_len, trace->column_capacity, char);
+  double *dst = (double *)trace->column;
+  for (size_t i = 0; i < len; i++) {
+    population_get_motion(population, trace->filtered ? trace->selected[i] : i,
+                          motion);
+    for (int k = 0; k < 4; k++) {
+      dst[k * len + i] = motion[k];
+    }
+  }
+  trace_write(trace, trace->column, target_len);
+}
+
+/**
+ * @brief Create a binary trace file and write its header
+ *
+ * If \c shared_trace is set in the configuration, all the processes of \p
+ * comm open the same file trace.bin in \p directory , and must call this
+ * function, \c trace_end_step() and \c free_trace() together. Otherwise each
+ * process opens its own file trace_{rank}.bin .
+ *
+ * @param[in] directory path of the directory where to store the file, not NULL
+ * @param[in] cfg global configuration, recorded in the header
+ * @param[in] comm communicator of all the processes
+ * @return trace_t* dynamically allocated trace, NULL if error
+ */
+trace_t *create_trace(const char *directory, global_config_t *cfg,
+                      MPI_Comm comm) {
+  trace_t *trace = malloc(sizeof(trace_t));
+  trace_header_t header;
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  trace->shared = cfg->shared_trace;
+  trace->writer = NULL;
+  trace->fh = MPI_FILE_NULL;
+  trace->comm = comm;
+  trace->offset = 0;
+  trace->buffers[0] = trace->buffers[1] = NULL;
+  trace->buffer_capacity[0] = trace->buffer_capacity[1] = 0;
+  trace->current = 0;
+  trace->request = MPI_REQUEST_NULL;
+  trace->step_offset = sizeof(trace_header_t);
+  trace->index = NULL;
+  trace->index_len = trace->index_capacity = 0;
+  trace->filtered = cfg->trace_sample_rate < 1. ||
+                    isfinite(cfg->trace_region[0]) ||
+                    isfinite(cfg->trace_region[1]) ||
+                    isfinite(cfg->trace_region[2]) ||
+                    isfinite(cfg->trace_region[3]);
+  /* A threshold of zero disables the sampling, as a rate of 1 would overflow */
+  trace->sample_threshold = cfg->trace_sample_rate < 1.
+                                ? cfg->trace_sample_rate * 0x1p64
+                                : 0;
+  trace->sample_seed = cfg->rand_seed;
+  memcpy(trace->region, cfg->trace_region, sizeof(trace->region));
+  trace->selected = NULL;
+  trace->selected_capacity = 0;
+  trace->column = NULL;
+  trace->column_capacity = 0;
+
+  /* Determine the filename and open the file */
+  char *path = malloc(PATH_MAX * sizeof(char));
+  if (trace->shared) {
+    sprintf(path, "%s/trace.bin", directory);
+    /* Remove any previous, longer file, as MPI_MODE_CREATE does not truncate
+     * it */
+    if (rank == ROOT_RANK) {
+      MPI_File_delete(path, MPI_INFO_NULL);
+    }
+    MPI_Barrier(comm);
+    if (MPI_File_open(comm, path, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &trace->fh) != MPI_SUCCESS) {
+      log_error("Cannot open file \"%s\" for writing", path);
+      free(path);
+      free(trace);
+      return NULL;
+    }
+  } else {
+    sprintf(path, "%s/trace_%d.bin", directory, rank);
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+      log_error("Cannot open file \"%s\" for writing", path);
+      free(path);
+      free(trace);
+      return NULL;
+    }
+    trace->writer = create_writer(file);
+    if (!trace->writer) {
+      fclose(file);
+      free(path);
+      free(trace);
+      return NULL;
+    }
+  }
+  free(path);
+
+  /* Write the header */
+  if (trace->shared) {
+    if (rank == ROOT_RANK) {
+      fill_trace_header(&header, -1, cfg);
+      MPI_File_write_at(trace->fh, 0, &header, sizeof(header), MPI_BYTE,
+                        MPI_STATUS_IGNORE);
+    }
+  } else {
+    fill_trace_header(&header, rank, cfg);
+    trace_write(trace, &header, sizeof(header));
+  }
+  return trace;
+}
+
+/**
+ * @brief Write in the given trace the details of a population, as a block of
+ * columns
+ *
+ * The columns are copied straight from the arrays of the population, unless
+ * the trace is filtered: then the individuals in the sample and in the region
+ * are selected first, and only their items are gathered. The columns of the
+ * motion and of \c t_status are always gathered, as they are converted.
+ *
+ * @param[in,out] trace trace, not NULL
+ * @param[in] population population to be written
+ * @param[in] country country the population belongs to
+ * @param[in] t current time
+ */
+void trace_write_step(trace_t *trace, population_t *population, int country,
+                      unsigned long t) {
+  size_t len = population->len;
+
+  /* Select the traced individuals */
+  if (trace->filtered) {
+    const double *r = trace->region;
+    DYN_ARRAY_EXTEND(trace->selected, population->len,
+                     trace->selected_capacity, size_t);
+    len = 0;
+    for (size_t i = 0; i < population->len; i++) {
+      double motion[4];
+      population_get_motion(population, i, motion);
+      if (motion[0] < r[0] || motion[0] >= r[1] || motion[1] < r[2] ||
+          motion[1] >= r[3]) {
+        continue;
+      }
+      if (trace->sample_threshold != 0 &&
+          hash_id(population->id[i], trace->sample_seed) >=
+              trace->sample_threshold) {
+        continue;
+      }
+      trace->selected[len++] = i;
+    }
+  }
+
+  /* Add the block to the index, unless the whole step is indexed */
+  if (!trace->shared) {
+    trace_index_entry_t entry = {t, country, 0, trace->offset};
+    DYN_ARRAY_APPEND(entry, trace->index, trace->index_len,
+                     trace->index_capacity, trace_index_entry_t);
+  }
+
+  /* NOTE: unsigned long is a uint64_t */
+  trace_block_t block = {t, country, 0, len};
+  trace_write(trace, &block, sizeof(block));
+  if (trace->filtered) {
+    trace_write_selected(trace, population->id, sizeof(unsigned long), len);
+    trace_write_motion(trace, population, len);
+    trace_write_t_status(trace, population, len);
+    trace_write_selected(trace, population->status, sizeof(unsigned char),
+                         len);
+    return;
+  }
+  trace_write(trace, population->id, len * sizeof(unsigned long));
+  trace_write_motion(trace, population, len);
+  trace_write_t_status(trace, population, len);
+  trace_write(trace, population->status, len * sizeof(unsigned char));
+}
+
+/**
+ * @brief Completes the current step of a trace
+ *
+ * If the trace is shared, the blocks of the step are written collectively,
+ * each process at the offset given by the exclusive prefix sum of the sizes of
+ * the blocks of the previous ranks. The write is non-blocking, and it is only
+ * waited for at the end of the next step, before reusing its buffer. Otherwise
+ * the blocks are handed over to the thread of the writer.
+ *
+ * The blocks of a step of each process must be smaller than 2 GB, the limit
+ * of a single MPI write.
+ *
+ * @param[in,out] trace trace, not NULL
+ * @param[in] t current time
+ */
+void trace_end_step(trace_t *trace, unsigned long t) {
+  if (!trace->shared) {
+    writer_flush(trace->writer);
+    return;
+  }
+  int rank;
+  uint64_t len = trace->offset, offset = 0, total;
+  MPI_Comm_rank(trace->comm, &rank);
+  /* NOTE: uint64_t is an unsigned long */
+  MPI_Exscan(&len, &offset, 1, MPI_UNSIGNED_LONG, MPI_SUM, trace->comm);
+  MPI_Allreduce(&len, &total, 1, MPI_UNSIGNED_LONG, MPI_SUM, trace->comm);
+  /* MPI_Exscan leaves the result undefined on the first rank */
+  if (rank == 0) {
+    offset = 0;
+  }
+  /* The previous step must be on disk before its buffer is filled again */
+  MPI_Wait(&trace->request, MPI_STATUS_IGNORE);
+  MPI_File_iwrite_at_all(trace->fh, trace->step_offset + offset,
+                         trace->buffers[trace->current], len, MPI_BYTE,
+                         &trace->request);
+  trace->current = 1 - trace->current;
+
+  /* Index the step on root */
+  if (rank == ROOT_RANK) {
+    trace_index_entry_t entry = {t, -1, 0, trace->step_offset};
+    DYN_ARRAY_APPEND(entry, trace->index, trace->index_len,
+                     trace->index_capacity, trace_index_entry_t);
+  }
+  trace->step_offset += total;
+  trace->offset = 0;
+}
+
+/**
+ * @brief Writes the step index and the footer of a trace, then closes it and
+ * frees its buffers
+ *
+ * @param[in,out] trace dynamically allocated trace, NULL is ignored
+ */
+void free_trace(trace_t *trace) {
+  if (!trace) {
+    return;
+  }
+  trace_footer_t footer;
+  memset(&footer, 0, sizeof(footer));
+  footer.index_len = trace->index_len;
+  memcpy(footer.magic, TRACE_INDEX_MAGIC, sizeof(footer.magic));
+  if (trace->shared) {
+    int rank;
+    MPI_Wait(&trace->request, MPI_STATUS_IGNORE);
+    MPI_Comm_rank(trace->comm, &rank);
+    if (rank == ROOT_RANK) {
+      size_t index_size = trace->index_len * sizeof(trace_index_entry_t);
+      footer.index_offset = trace->step_offset;
+      MPI_File_write_at(trace->fh, trace->step_offset, trace->index,
+                        index_size, MPI_BYTE, MPI_STATUS_IGNORE);
+      MPI_File_write_at(trace->fh, trace->step_offset + index_size, &footer,
+                        sizeof(footer), MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+    MPI_File_close(&trace->fh);
+  } else {
+    footer.index_offset = trace->offset;
+    trace_write(trace, trace->index,
+                trace->index_len * sizeof(trace_index_entry_t));
+    trace_write(trace, &footer, sizeof(footer));
+    free_writer(trace->writer);
+  }
+  free(trace->buffers[0]);
+  free(trace->buffers[1]);
+  free(trace->index);
+  free(trace->selected);
+  free(trace->column);
+  free(trace);
+}
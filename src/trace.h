@@ -0,0 +1,127 @@
+#pragma once
+
+#include <limits.h>
+#include <mpi.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "population.h"
+#include "utils.h"
+#include "writer.h"
+
+/*
+ * Binary trace file, in the native byte order:
+ *  - trace_header_t , with the configuration of the simulation
+ *  - one block for each country at each step: trace_block_t , followed by the
+ *    columns id (uint64), pos_x, pos_y, displ_x, displ_y (double), t_status
+ *    (uint64) and status (uint8), each with \c len items, only for the
+ *    individuals selected by the filters of the header
+ *  - the step index: an array of trace_index_entry_t , one for each block
+ *  - trace_footer_t , to locate the index from the end of the file
+ *
+ * A trace shared by all the processes has rank -1 in the header, and the
+ * blocks of each step are contiguous, in the order of the ranks of the
+ * writers. The index has a single entry for each step, with country -1,
+ * locating its first block: the following ones are found from the length of
+ * each block, up to the next entry or to the index.
+ */
+
+#define TRACE_MAGIC "MPITRACE"
+#define TRACE_INDEX_MAGIC "TRACEIDX"
+#define TRACE_VERSION 2
+
+/**
+ * @brief Header of a trace file, recording the configuration
+ */
+typedef struct trace_header {
+  char magic[8]; /**< TRACE_MAGIC , not null-terminated */
+  uint32_t version;
+  int32_t rank; /**< Rank of the process that wrote the file */
+  uint64_t num_individuals, inf_individuals;
+  uint64_t world_w, world_l, country_w, country_l;
+  double velocity;
+  double spreading_distance;
+  uint64_t t_infection, t_recovery, t_immunity;
+  uint64_t t_step, t_target;
+  uint64_t rand_seed;
+  uint64_t trace_every;     /**< Steps between traced steps */
+  double trace_sample_rate; /**< Fraction of the ids that are traced */
+  double trace_region[4];   /**< xmin, xmax, ymin, ymax of the traced region */
+} trace_header_t;
+
+/**
+ * @brief Header of the block of a country at a step, followed by its columns
+ */
+typedef struct trace_block {
+  uint64_t t;       /**< Time of the step */
+  int32_t country;  /**< Index of the country */
+  uint32_t padding; /**< Always zero */
+  uint64_t len;     /**< Number of individuals */
+} trace_block_t;
+
+/**
+ * @brief Entry of the step index, locating a block
+ */
+typedef struct trace_index_entry {
+  uint64_t t;       /**< Time of the step */
+  int32_t country;  /**< Index of the country */
+  uint32_t padding; /**< Always zero */
+  uint64_t offset;  /**< Offset of the block from the start of the file */
+} trace_index_entry_t;
+
+/**
+ * @brief Footer of a trace file
+ */
+typedef struct trace_footer {
+  uint64_t index_offset; /**< Offset of the index from the start of the file */
+  uint64_t index_len;    /**< Number of entries in the index */
+  char magic[8];         /**< TRACE_INDEX_MAGIC , not null-terminated */
+} trace_footer_t;
+
+/**
+ * @brief Trace file being written by a process, either on its own or shared
+ * with the others
+ *
+ * In both cases the blocks of a step are written while the simulation goes on:
+ * by the thread of \c writer , or by a non-blocking collective write from one
+ * of the two step buffers.
+ */
+typedef struct trace {
+  bool shared;       /**< Whether the file is shared by all the processes */
+  writer_t *writer;  /**< Writer of the own file, if not shared */
+  MPI_File fh;       /**< Shared file, if shared */
+  MPI_Comm comm;     /**< Communicator of the processes sharing the file */
+  uint64_t offset;   /**< Current offset from the start of the file, or of the
+                        step buffer if shared */
+  char *buffers[2];  /**< Blocks of the current and of the previous step, if
+                        shared */
+  size_t buffer_capacity[2];
+  int current;         /**< Index of the buffer of the current step */
+  MPI_Request request; /**< Write of the previous step, if shared */
+  uint64_t step_offset; /**< Offset of the next step in the file, if shared */
+  bool filtered;        /**< Whether only some individuals are traced */
+  uint64_t sample_threshold; /**< Ids whose hash is below it are traced, all
+                                if zero */
+  uint64_t sample_seed;
+  double region[4];    /**< xmin, xmax, ymin, ymax of the traced region */
+  size_t *selected;    /**< Indices of the traced individuals of a block */
+  size_t selected_capacity;
+  char *column;        /**< Column of a block, gathered from the population */
+  size_t column_capacity;
+  trace_index_entry_t *index; /**< Step index, only on root if shared */
+  size_t index_len;
+  size_t index_capacity;
+} trace_t;
+
+trace_t *create_trace(const char *directory, global_config_t *cfg,
+                      MPI_Comm comm);
+
+void trace_write_step(trace_t *trace, population_t *population, int country,
+                      unsigned long t);
+
+void trace_end_step(trace_t *trace, unsigned long t);
+
+void free_trace(trace_t *trace);
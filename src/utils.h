@@ -2,7 +2,6 @@
 
 #include <math.h>
 #include <stdlib.h>
-#include <sys/queue.h>
 #include <sys/stat.h>
 
 #include "log.h"
@@ -17,24 +16,9 @@
 
 #define ROOT_RANK 0
 
-#define RAND_DOUBLE(offset, range) \
-  (offset) + ((double)rand() * (range) / RAND_MAX)
-
 #define MAX(a, b) (a > b ? a : b)
 #define MIN(a, b) (a < b ? a : b)
 
-#define SLIST_REMOVE_AFTER(elm, field)                             \
-  do {                                                             \
-    (elm)->field.sle_next = (elm)->field.sle_next->field.sle_next; \
-  } while (0)
-
-#define SLIST_COUNT(head, field, type, count)       \
-  do {                                              \
-    *count = 0;                                     \
-    struct type *var;                               \
-    SLIST_FOREACH(var, head, field) { (*count)++; } \
-  } while (0)
-
 #define DYN_ARRAY_EXTEND(arr, target_len, capacity, type) \
   if (target_len > capacity) {                            \
     capacity = target_len + target_len % DYN_ARRAY_CHUNK; \
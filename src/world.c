@@ -60,4 +60,45 @@ int decode_cardinal_point_flag(unsigned char flag) {
     default:
       return -1;
   }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Encode a cardinal point as a flag in which each bit represents the
+ * cardinal points NSWE.
+ *
+ * This is the inverse of \c decode_cardinal_point_flag() (ex. NORTH_WEST is
+ * encoded with both the NORTH and WEST bits set).
+ *
+ * @param[in] point cardinal point, as in \c enum \c cardinal_point
+ * @return the corresponding flag, 0 if error
+ */
+unsigned char encode_cardinal_point_flag(int point) {
+  switch (point) {
+    case NORTH: {
+      return 1 << NORTH;
+    }
+    case NORTH_EAST: {
+      return 1 << NORTH | 1 << EAST;
+    }
+    case EAST: {
+      return 1 << EAST;
+    }
+    case SOUTH_EAST: {
+      return 1 << SOUTH | 1 << EAST;
+    }
+    case SOUTH: {
+      return 1 << SOUTH;
+    }
+    case SOUTH_WEST: {
+      return 1 << SOUTH | 1 << WEST;
+    }
+    case WEST: {
+      return 1 << WEST;
+    }
+    case NORTH_WEST: {
+      return 1 << NORTH | 1 << WEST;
+    }
+    default:
+      return 0;
+  }
+}
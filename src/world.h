@@ -34,3 +34,5 @@ void distribute_population_uniform(unsigned long population,
                                    unsigned long res[]);
 
 int decode_cardinal_point_flag(unsigned char flag);
+
+unsigned char encode_cardinal_point_flag(int point);
@@ -0,0 +1,144 @@
+#include "writer.h"
+
+/**
+ * @brief Body of the thread of a writer: writes each buffer it is handed to
+ * the file, until the writer is closed
+ *
+ * @param[in,out] arg writer_t*
+ * @return void* always NULL
+ */
+static void *writer_loop(void *arg) {
+  writer_t *writer = arg;
+  pthread_mutex_lock(&writer->mutex);
+  while (true) {
+    while (!writer->pending && !writer->closing) {
+      pthread_cond_wait(&writer->cond, &writer->mutex);
+    }
+    if (!writer->pending) {
+      break;
+    }
+    /* The main thread does not touch the other buffer until it is released */
+    int k = 1 - writer->current;
+    pthread_mutex_unlock(&writer->mutex);
+    if (fwrite(writer->buffers[k], 1, writer->len[k], writer->file) !=
+        writer->len[k]) {
+      log_error("Cannot write %lu bytes to file", writer->len[k]);
+    }
+    fflush(writer->file);
+    writer->len[k] = 0;
+    pthread_mutex_lock(&writer->mutex);
+    writer->pending = false;
+    pthread_cond_signal(&writer->cond);
+  }
+  pthread_mutex_unlock(&writer->mutex);
+  return NULL;
+}
+
+/**
+ * @brief Creates a writer for a file and starts its thread
+ *
+ * @param[in] file file pointer with write access, owned by the writer from now
+ * on, not NULL
+ * @return writer_t* dynamically allocated writer, NULL if error
+ */
+writer_t *create_writer(FILE *file) {
+  writer_t *writer = malloc(sizeof(writer_t));
+  writer->file = file;
+  for (int k = 0; k < 2; k++) {
+    writer->buffers[k] = NULL;
+    writer->len[k] = writer->capacity[k] = 0;
+  }
+  writer->current = 0;
+  writer->pending = writer->closing = false;
+  pthread_mutex_init(&writer->mutex, NULL);
+  pthread_cond_init(&writer->cond, NULL);
+  if (pthread_create(&writer->thread, NULL, writer_loop, writer) != 0) {
+    log_error("Cannot start the writer thread");
+    pthread_mutex_destroy(&writer->mutex);
+    pthread_cond_destroy(&writer->cond);
+    free(writer);
+    return NULL;
+  }
+  return writer;
+}
+
+/**
+ * @brief Copies raw data at the end of the current buffer of a writer
+ *
+ * @param[in,out] writer
+ * @param[in] data
+ * @param[in] size number of bytes
+ */
+void writer_append(writer_t *writer, const void *data, size_t size) {
+  const int k = writer->current;
+  size_t target_len = writer->len[k] + size;
+  DYN_ARRAY_EXTEND(writer->buffers[k], target_len, writer->capacity[k], char);
+  memcpy(writer->buffers[k] + writer->len[k], data, size);
+  writer->len[k] = target_len;
+}
+
+/**
+ * @brief Formats a string at the end of the current buffer of a writer
+ *
+ * @param[in,out] writer
+ * @param[in] format format string, as for \c printf()
+ */
+void writer_printf(writer_t *writer, const char *format, ...) {
+  const int k = writer->current;
+  va_list args;
+  va_start(args, format);
+  int size = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+  /* Leave room for the terminator written by vsnprintf() */
+  size_t target_len = writer->len[k] + size + 1;
+  DYN_ARRAY_EXTEND(writer->buffers[k], target_len, writer->capacity[k], char);
+  va_start(args, format);
+  vsnprintf(writer->buffers[k] + writer->len[k], size + 1, format, args);
+  va_end(args);
+  writer->len[k] += size;
+}
+
+/**
+ * @brief Hands the current buffer of a writer over to its thread
+ *
+ * Waits only if the thread has not yet written the previous buffer.
+ *
+ * @param[in,out] writer
+ */
+void writer_flush(writer_t *writer) {
+  if (writer->len[writer->current] == 0) {
+    return;
+  }
+  pthread_mutex_lock(&writer->mutex);
+  while (writer->pending) {
+    pthread_cond_wait(&writer->cond, &writer->mutex);
+  }
+  writer->current = 1 - writer->current;
+  writer->pending = true;
+  pthread_cond_signal(&writer->cond);
+  pthread_mutex_unlock(&writer->mutex);
+}
+
+/**
+ * @brief Writes the remaining data of a writer, stops its thread, closes the
+ * file and frees the buffers
+ *
+ * @param[in,out] writer dynamically allocated writer, NULL is ignored
+ */
+void free_writer(writer_t *writer) {
+  if (!writer) {
+    return;
+  }
+  writer_flush(writer);
+  pthread_mutex_lock(&writer->mutex);
+  writer->closing = true;
+  pthread_cond_signal(&writer->cond);
+  pthread_mutex_unlock(&writer->mutex);
+  pthread_join(writer->thread, NULL);
+  pthread_mutex_destroy(&writer->mutex);
+  pthread_cond_destroy(&writer->cond);
+  fclose(writer->file);
+  free(writer->buffers[0]);
+  free(writer->buffers[1]);
+  free(writer);
+}
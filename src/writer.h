@@ -0,0 +1,41 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+/**
+ * @brief File written by a dedicated thread, through a pair of buffers
+ *
+ * The main thread fills the current buffer and hands it over with \c
+ * writer_flush() , then goes on filling the other one while the thread writes
+ * it to disk. It only waits if the thread is still writing the previous buffer.
+ */
+typedef struct writer {
+  FILE *file;
+  char *buffers[2];
+  size_t len[2];
+  size_t capacity[2];
+  int current;  /**< Index of the buffer being filled by the main thread */
+  bool pending; /**< Whether the other buffer is yet to be written */
+  bool closing; /**< Whether the thread should stop once done */
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond; /**< Signals a change of \c pending or \c closing */
+} writer_t;
+
+writer_t *create_writer(FILE *file);
+
+void writer_append(writer_t *writer, const void *data, size_t size);
+
+void writer_printf(writer_t *writer, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+void writer_flush(writer_t *writer);
+
+void free_writer(writer_t *writer);
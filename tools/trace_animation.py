@@ -13,20 +13,19 @@ status_color = {
 }
 
 
-def load_data(res_dir: Path, countries):
-    # Parse and merge csv files
+def load_data(res_dir: Path):
+    # Parse and merge csv files, one for each process
     df = pd.DataFrame()
-    for c in range(countries):
-        filepath = res_dir.joinpath(f'trace_{c}.csv')
+    for filepath in sorted(res_dir.glob('trace*.csv')):
         df_c = pd.read_csv(filepath, index_col=['t', 'id'])
         df = df.append(df_c)
 
     return df
 
 
-def main(res_dir: Path, countries, world_w, world_l, country_w, country_l, t_step, t_target=None):
+def main(res_dir: Path, world_w, world_l, country_w, country_l, t_step, t_target=None):
     print("Loading data...")
-    df = load_data(res_dir, countries)
+    df = load_data(res_dir)
 
     # Compute additional parameters from given data
     cols, rows = int(world_w // country_w), int(world_l // country_l)
@@ -79,15 +78,13 @@ def main(res_dir: Path, countries, world_w, world_l, country_w, country_l, t_ste
 if __name__ == '__main__':
     # Set up the parameters
     res_dir = Path.cwd().joinpath('../src/results')
-    countries = 4
     world_w, world_l = 2e3, 2e3
     country_w, country_l = 1e3, 1e3
     t_step = 1
     t_target = 600
 
     # Call the main function
-    main(res_dir, countries, world_w, world_l,
-         country_w, country_l, t_step, t_target)
+    main(res_dir, world_w, world_l, country_w, country_l, t_step, t_target)
 
 # Suggested running parameters (for make run)
 # @mpirun -np 4 --oversubscribe $(exec) \
@@ -0,0 +1,119 @@
+import sys
+import struct
+import numpy as np
+import pandas as pd
+from pathlib import Path
+
+# Layout of the binary trace, see src/trace.h
+HEADER = struct.Struct('=8sIi6Q2d5QQQ5d')
+TRACE_VERSION = 2
+HEADER_FIELDS = [
+    'magic', 'version', 'rank',
+    'num_individuals', 'inf_individuals',
+    'world_w', 'world_l', 'country_w', 'country_l',
+    'velocity', 'spreading_distance',
+    't_infection', 't_recovery', 't_immunity', 't_step', 't_target',
+    'rand_seed', 'trace_every', 'trace_sample_rate',
+    'region_xmin', 'region_xmax', 'region_ymin', 'region_ymax',
+]
+BLOCK = struct.Struct('=QiIQ')
+INDEX_ENTRY = np.dtype([('t', '=u8'), ('country', '=i4'), ('padding', '=u4'),
+                        ('offset', '=u8')])
+FOOTER = struct.Struct('=QQ8s')
+
+STATUS_STRING = np.array(['NOT_EXPOSED', 'EXPOSED', 'INFECTED', 'IMMUNE'])
+
+
+def read_header(f):
+    f.seek(0)
+    header = dict(zip(HEADER_FIELDS, HEADER.unpack(f.read(HEADER.size))))
+    if header['magic'] != b'MPITRACE':
+        raise ValueError(f'{f.name} is not a trace file')
+    if header['version'] != TRACE_VERSION:
+        raise ValueError(f'{f.name} has trace version {header["version"]}, '
+                         f'expected {TRACE_VERSION}')
+    return header
+
+
+def read_index(f):
+    # The footer at the end of the file locates the index
+    f.seek(-FOOTER.size, 2)
+    index_offset, index_len, magic = FOOTER.unpack(f.read(FOOTER.size))
+    if magic != b'TRACEIDX':
+        raise ValueError(f'{f.name} is incomplete')
+    f.seek(index_offset)
+    index = np.fromfile(f, dtype=INDEX_ENTRY, count=index_len)
+    return index, index_offset
+
+
+def block_offsets(f, index, ends):
+    # Entries with country -1 locate a whole step of a shared trace, whose
+    # blocks follow each other up to its end
+    offsets = []
+    for entry, end in zip(index, ends):
+        if entry['country'] >= 0:
+            offsets.append(int(entry['offset']))
+            continue
+        offset = int(entry['offset'])
+        while offset < end:
+            offsets.append(offset)
+            f.seek(offset)
+            n = BLOCK.unpack(f.read(BLOCK.size))[3]
+            offset += block_size(n)
+    return offsets
+
+
+def block_size(n):
+    # Header, then columns of 8 bytes except for the status
+    return BLOCK.size + n * (6 * 8 + 1)
+
+
+def read_block(f, offset):
+    f.seek(offset)
+    t, country, _, n = BLOCK.unpack(f.read(BLOCK.size))
+    columns = {'country': np.full(n, country), 't': np.full(n, t)}
+    columns['id'] = np.fromfile(f, dtype='=u8', count=n)
+    for name in ['pos_x', 'pos_y', 'displ_x', 'displ_y']:
+        columns[name] = np.fromfile(f, dtype='=f8', count=n)
+    t_status = np.fromfile(f, dtype='=u8', count=n)
+    columns['status'] = STATUS_STRING[np.fromfile(f, dtype='=u1', count=n)]
+    columns['t_status'] = t_status
+    return pd.DataFrame(columns)
+
+
+def load_trace(path: Path, t_min=0, t_max=None):
+    # Only the blocks of the requested steps are read, thanks to the index
+    with open(path, 'rb') as f:
+        read_header(f)
+        index, index_offset = read_index(f)
+        # Keep the end of each step before filtering
+        ends = np.append(index['offset'][1:], index_offset)
+        mask = index['t'] >= t_min
+        if t_max is not None:
+            mask &= index['t'] <= t_max
+        offsets = block_offsets(f, index[mask], ends[mask])
+        blocks = [read_block(f, offset) for offset in offsets]
+    if not blocks:
+        return pd.DataFrame(columns=['country', 't', 'id', 'pos_x', 'pos_y',
+                                     'displ_x', 'displ_y', 'status',
+                                     't_status'])
+    return pd.concat(blocks, ignore_index=True)
+
+
+def main(res_dir: Path, t_min=0, t_max=None):
+    # Convert each binary trace to the csv read by trace_animation.py
+    for path in sorted(res_dir.glob('trace*.bin')):
+        print(f'Converting {path.name}...')
+        df = load_trace(path, t_min, t_max)
+        df.to_csv(path.with_suffix('.csv'), index=False, float_format='%.3f')
+
+
+if __name__ == '__main__':
+    # Usage: python3 trace_to_csv.py [results_dir [t_min [t_max]]]
+    res_dir = Path(sys.argv[1]) if len(sys.argv) > 1 \
+        else Path.cwd().joinpath('../src/results')
+    t_min = int(sys.argv[2]) if len(sys.argv) > 2 else 0
+    t_max = int(sys.argv[3]) if len(sys.argv) > 3 else None
+
+    # Call the main function
+    main(res_dir, t_min, t_max)